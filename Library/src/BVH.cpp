@@ -0,0 +1,172 @@
+#include "BVH.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	void BVH::Build(const std::vector<AABB>& primitiveBounds)
+	{
+		m_PrimitiveBounds = primitiveBounds;
+
+		const uint32_t nrPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+		m_PrimitiveOrder.resize(nrPrimitives);
+		for (uint32_t idx{}; idx < nrPrimitives; ++idx)
+			m_PrimitiveOrder[idx] = idx;
+		m_PrimitiveLeaves.assign(nrPrimitives, INVALID_NODE);
+
+		m_Nodes.clear();
+		if (nrPrimitives == 0)
+			return;
+
+		m_Nodes.reserve(2 * (nrPrimitives / MAX_LEAF_PRIMITIVES + 1));
+		BuildRecursive(0, nrPrimitives, INVALID_NODE);
+	}
+
+	void BVH::UpdatePrimitive(uint32_t primitiveIdx, const AABB& bounds)
+	{
+		m_PrimitiveBounds[primitiveIdx] = bounds;
+
+		uint32_t nodeIdx{ m_PrimitiveLeaves[primitiveIdx] };
+		while (nodeIdx != INVALID_NODE)
+		{
+			const AABB previousBounds{ m_Nodes[nodeIdx].bounds };
+			RefitNode(nodeIdx);
+
+			// Nothing above can change anymore
+			if (m_Nodes[nodeIdx].bounds == previousBounds)
+				break;
+
+			nodeIdx = m_Nodes[nodeIdx].parent;
+		}
+	}
+
+	void BVH::CullFrustum(const Frustum& frustum, std::vector<uint32_t>& visiblePrimitives, BVHCullStats& stats) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		struct StackEntry
+		{
+			uint32_t nodeIdx{};
+			uint32_t planeMask{};
+		};
+
+		constexpr uint32_t allPlanes{ (1u << Frustum::NR_PLANES) - 1 };
+		std::vector<StackEntry> stack{ { 0, allPlanes } };
+
+		while (!stack.empty())
+		{
+			StackEntry entry{ stack.back() };
+			stack.pop_back();
+
+			const Node& node{ m_Nodes[entry.nodeIdx] };
+			++stats.nodesVisited;
+
+			switch (frustum.Test(node.bounds, entry.planeMask))
+			{
+			case Frustum::Intersection::Outside:
+				++stats.nodesCulled;
+				break;
+			case Frustum::Intersection::Inside:
+				// Fully inside, no need to test anything below
+				AddSubtree(entry.nodeIdx, visiblePrimitives);
+				break;
+			case Frustum::Intersection::Intersecting:
+				if (node.IsLeaf())
+				{
+					for (uint32_t idx{ node.firstPrimitive }; idx < node.firstPrimitive + node.nrPrimitives; ++idx)
+					{
+						uint32_t primitiveMask{ entry.planeMask };
+						if (frustum.Test(m_PrimitiveBounds[m_PrimitiveOrder[idx]], primitiveMask) != Frustum::Intersection::Outside)
+							visiblePrimitives.push_back(m_PrimitiveOrder[idx]);
+					}
+				}
+				else
+				{
+					stack.push_back({ node.right, entry.planeMask });
+					stack.push_back({ node.left, entry.planeMask });
+				}
+				break;
+			}
+		}
+	}
+
+	uint32_t BVH::BuildRecursive(uint32_t first, uint32_t count, uint32_t parent)
+	{
+		const uint32_t nodeIdx{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes.push_back({});
+		m_Nodes[nodeIdx].parent = parent;
+
+		AABB centerBounds{};
+		for (uint32_t idx{ first }; idx < first + count; ++idx)
+			centerBounds.Grow(m_PrimitiveBounds[m_PrimitiveOrder[idx]].GetCenter());
+
+		if (count <= MAX_LEAF_PRIMITIVES)
+		{
+			m_Nodes[nodeIdx].firstPrimitive = first;
+			m_Nodes[nodeIdx].nrPrimitives = count;
+			for (uint32_t idx{ first }; idx < first + count; ++idx)
+				m_PrimitiveLeaves[m_PrimitiveOrder[idx]] = nodeIdx;
+
+			RefitNode(nodeIdx);
+			return nodeIdx;
+		}
+
+		// Median split along the axis where the centers are spread the most
+		const Vector3 centerExtents{ centerBounds.max - centerBounds.min };
+		int axis{ 0 };
+		if (centerExtents.y > centerExtents[axis])
+			axis = 1;
+		if (centerExtents.z > centerExtents[axis])
+			axis = 2;
+
+		const uint32_t half{ count / 2 };
+		const auto begin{ m_PrimitiveOrder.begin() + first };
+		std::nth_element(begin, begin + half, begin + count, [this, axis](uint32_t a, uint32_t b)
+		{
+			return m_PrimitiveBounds[a].GetCenter()[axis] < m_PrimitiveBounds[b].GetCenter()[axis];
+		});
+
+		// m_Nodes can grow while building the children, so don't hold on to references
+		const uint32_t left{ BuildRecursive(first, half, nodeIdx) };
+		const uint32_t right{ BuildRecursive(first + half, count - half, nodeIdx) };
+		m_Nodes[nodeIdx].left = left;
+		m_Nodes[nodeIdx].right = right;
+
+		RefitNode(nodeIdx);
+		return nodeIdx;
+	}
+
+	void BVH::RefitNode(uint32_t nodeIdx)
+	{
+		Node& node{ m_Nodes[nodeIdx] };
+
+		AABB bounds{};
+		if (node.IsLeaf())
+		{
+			for (uint32_t idx{ node.firstPrimitive }; idx < node.firstPrimitive + node.nrPrimitives; ++idx)
+				bounds.Grow(m_PrimitiveBounds[m_PrimitiveOrder[idx]]);
+		}
+		else
+		{
+			bounds.Grow(m_Nodes[node.left].bounds);
+			bounds.Grow(m_Nodes[node.right].bounds);
+		}
+
+		node.bounds = bounds;
+	}
+
+	void BVH::AddSubtree(uint32_t nodeIdx, std::vector<uint32_t>& visiblePrimitives) const
+	{
+		const Node& node{ m_Nodes[nodeIdx] };
+		if (node.IsLeaf())
+		{
+			for (uint32_t idx{ node.firstPrimitive }; idx < node.firstPrimitive + node.nrPrimitives; ++idx)
+				visiblePrimitives.push_back(m_PrimitiveOrder[idx]);
+			return;
+		}
+
+		AddSubtree(node.left, visiblePrimitives);
+		AddSubtree(node.right, visiblePrimitives);
+	}
+}
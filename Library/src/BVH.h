@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct BVHCullStats
+	{
+		uint32_t nodesVisited{};
+		uint32_t nodesCulled{};
+	};
+
+	// Bounding volume hierarchy over world space boxes, one per primitive (e.g. a mesh instance)
+	class BVH final
+	{
+	public:
+		void Build(const std::vector<AABB>& primitiveBounds);
+
+		// Refits the primitive's leaf and walks up, stops at the first ancestor whose bounds don't change
+		void UpdatePrimitive(uint32_t primitiveIdx, const AABB& bounds);
+
+		// Appends every primitive whose box is at least partially inside the frustum
+		void CullFrustum(const Frustum& frustum, std::vector<uint32_t>& visiblePrimitives, BVHCullStats& stats) const;
+
+		size_t GetNrPrimitives() const { return m_PrimitiveBounds.size(); }
+		const AABB& GetPrimitiveBounds(uint32_t primitiveIdx) const { return m_PrimitiveBounds[primitiveIdx]; }
+
+	private:
+		static constexpr uint32_t MAX_LEAF_PRIMITIVES{ 4 };
+		static constexpr uint32_t INVALID_NODE{ UINT32_MAX };
+
+		struct Node
+		{
+			AABB bounds{};
+			uint32_t parent{ INVALID_NODE };
+			uint32_t left{ INVALID_NODE };
+			uint32_t right{ INVALID_NODE };
+			// Leaves only, range in m_PrimitiveOrder
+			uint32_t firstPrimitive{};
+			uint32_t nrPrimitives{};
+
+			bool IsLeaf() const { return nrPrimitives > 0; }
+		};
+
+		uint32_t BuildRecursive(uint32_t first, uint32_t count, uint32_t parent);
+		void RefitNode(uint32_t nodeIdx);
+		void AddSubtree(uint32_t nodeIdx, std::vector<uint32_t>& visiblePrimitives) const;
+
+		std::vector<Node> m_Nodes{};
+		std::vector<AABB> m_PrimitiveBounds{};
+		std::vector<uint32_t> m_PrimitiveOrder{};
+		std::vector<uint32_t> m_PrimitiveLeaves{};
+	};
+}
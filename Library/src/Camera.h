@@ -3,6 +3,7 @@
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
 
+#include "DataTypes.h"
 #include "Maths.h"
 #include "Timer.h"
 
@@ -23,6 +24,9 @@ namespace dae
 		float fovAngle{90.f};
 		float fov{ tanf((fovAngle * TO_RADIANS) / 2.f) };
 
+		float nearPlane{ 0.1f };
+		float farPlane{ 1000.f };
+
 		Vector3 forward{Vector3::UnitZ};
 		Vector3 up{Vector3::UnitY};
 		Vector3 right{Vector3::UnitX};
@@ -74,6 +78,33 @@ namespace dae
 			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
 		}
 
+		// World space planes of the view volume, matching the projection used by the renderer
+		Frustum GetFrustum(float aspectRatio) const
+		{
+			const float fovX{ fov * aspectRatio };
+
+			// View space planes, the side ones go through the camera origin
+			const Plane viewPlanes[Frustum::NR_PLANES]
+			{
+				{ Vector3::UnitZ, -nearPlane },
+				{ -Vector3::UnitZ, farPlane },
+				{ Vector3{ 1.f, 0.f, fovX }.Normalized(), 0.f },
+				{ Vector3{ -1.f, 0.f, fovX }.Normalized(), 0.f },
+				{ Vector3{ 0.f, 1.f, fov }.Normalized(), 0.f },
+				{ Vector3{ 0.f, -1.f, fov }.Normalized(), 0.f }
+			};
+
+			Frustum frustum{};
+			for (int planeIdx{}; planeIdx < Frustum::NR_PLANES; ++planeIdx)
+			{
+				const Plane& viewPlane{ viewPlanes[planeIdx] };
+				const Vector3 normal{ right * viewPlane.normal.x + up * viewPlane.normal.y + forward * viewPlane.normal.z };
+				frustum.planes[planeIdx] = { normal, viewPlane.distance - Vector3::Dot(normal, origin) };
+			}
+
+			return frustum;
+		}
+
 		void Update(Timer* pTimer)
 		{
 			const float deltaTime = pTimer->GetElapsed();
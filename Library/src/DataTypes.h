@@ -1,27 +1,51 @@
 #pragma once
+#include <memory>
+#include <span>
 #include "Maths.h"
 #include "vector"
 
 namespace dae
 {
+	class MappedFile;
+
 	struct Vertex
 	{
 		Vector3 position{};
 		ColorRGB color{colors::White};
-		//Vector2 uv{}; //W2
-		//Vector3 normal{}; //W4
-		//Vector3 tangent{}; //W4
-		//Vector3 viewDirection{}; //W4
+		Vector2 uv{}; //W2
+		Vector3 normal{}; //W4
+		Vector3 tangent{}; //W4
+		Vector3 viewDirection{}; //W4
+	};
+
+	// Compact alternative to Vertex (24 instead of 68 bytes), see VertexPacking
+	struct PackedVertex
+	{
+		uint16_t position[3]{};	// Quantized within VertexQuantization bounds
+		uint16_t uv[2]{};		// Half floats
+		uint16_t padding{};
+		uint32_t normal{};		// Octahedral, 2x snorm16
+		uint32_t tangent{};		// Octahedral, 2x snorm16
+		uint32_t color{};		// RGBA8 unorm
+	};
+
+	// Dequantization: position = offset + quantized * scale
+	struct VertexQuantization
+	{
+		Vector3 offset{};
+		Vector3 scale{};
 	};
 
 	struct Vertex_Out
 	{
-		Vector4 position{};
+		Vector4 position{}; // Screen x, screen y, NDC depth, view space depth
 		ColorRGB color{ colors::White };
-		//Vector2 uv{};
-		//Vector3 normal{};
-		//Vector3 tangent{};
-		//Vector3 viewDirection{};
+		Vector2 uv{};
+		// View space and not normalized, so they interpolate linearly
+		Vector3 normal{};
+		Vector3 tangent{};
+		// From the camera to the vertex, which is its view space position
+		Vector3 viewDirection{};
 	};
 
 	struct Triangle
@@ -65,6 +89,143 @@ namespace dae
 		int height{};
 	};
 
+	struct AABB
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		bool IsValid() const
+		{
+			return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+		}
+
+		Vector3 GetCenter() const
+		{
+			return (min + max) * 0.5f;
+		}
+
+		void Grow(const Vector3& point)
+		{
+			min = { std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z) };
+			max = { std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z) };
+		}
+
+		void Grow(const AABB& other)
+		{
+			Grow(other.min);
+			Grow(other.max);
+		}
+
+		// Arvo's method: transform the center, the extents go through the absolute matrix
+		AABB Transformed(const Matrix& matrix) const
+		{
+			const Vector3 center{ matrix.TransformPoint(GetCenter()) };
+			const Vector3 extents{ (max - min) * 0.5f };
+
+			const Vector3 axisX{ matrix.GetAxisX() };
+			const Vector3 axisY{ matrix.GetAxisY() };
+			const Vector3 axisZ{ matrix.GetAxisZ() };
+			const Vector3 transformedExtents{
+				std::abs(axisX.x) * extents.x + std::abs(axisY.x) * extents.y + std::abs(axisZ.x) * extents.z,
+				std::abs(axisX.y) * extents.x + std::abs(axisY.y) * extents.y + std::abs(axisZ.y) * extents.z,
+				std::abs(axisX.z) * extents.x + std::abs(axisY.z) * extents.y + std::abs(axisZ.z) * extents.z
+			};
+
+			return { center - transformedExtents, center + transformedExtents };
+		}
+
+		bool operator==(const AABB& other) const
+		{
+			return min == other.min && max == other.max;
+		}
+	};
+
+	// Points with Dot(normal, point) + distance >= 0 are on the inside
+	struct Plane
+	{
+		Vector3 normal{};
+		float distance{};
+	};
+
+	struct Frustum
+	{
+		enum class Intersection
+		{
+			Outside,
+			Intersecting,
+			Inside
+		};
+
+		static constexpr int NR_PLANES{ 6 };
+		Plane planes[NR_PLANES]{};
+
+		// planeMask has a bit per plane that still needs testing, planes the box is fully inside of get cleared
+		Intersection Test(const AABB& box, uint32_t& planeMask) const
+		{
+			const Vector3 center{ box.GetCenter() };
+			const Vector3 extents{ (box.max - box.min) * 0.5f };
+
+			for (int planeIdx{}; planeIdx < NR_PLANES; ++planeIdx)
+			{
+				const uint32_t planeBit{ 1u << planeIdx };
+				if (!(planeMask & planeBit))
+					continue;
+
+				const Plane& plane{ planes[planeIdx] };
+				const float centerDistance{ Vector3::Dot(plane.normal, center) + plane.distance };
+				const float radius{ std::abs(plane.normal.x) * extents.x + std::abs(plane.normal.y) * extents.y + std::abs(plane.normal.z) * extents.z };
+
+				if (centerDistance + radius < 0.f)
+					return Intersection::Outside;
+				if (centerDistance - radius >= 0.f)
+					planeMask &= ~planeBit;
+			}
+
+			return planeMask ? Intersection::Intersecting : Intersection::Inside;
+		}
+
+		bool IsSphereVisible(const Vector3& center, float radius) const
+		{
+			for (const Plane& plane : planes)
+			{
+				if (Vector3::Dot(plane.normal, center) + plane.distance < -radius)
+					return false;
+			}
+			return true;
+		}
+	};
+
+	// Small cluster of a triangle list, see MeshletBuilder
+	struct Meshlet
+	{
+		// Bounding sphere
+		Vector3 center{};
+		float radius{};
+
+		// Every triangle faces away from a camera inside this cone, see MeshletBuilder::IsBackFacing
+		Vector3 coneApex{};
+		Vector3 coneAxis{};
+		float coneCutoff{};
+
+		uint32_t vertexOffset{};	// Into Mesh::meshletVertices
+		uint32_t triangleOffset{};	// Into Mesh::meshletTriangles, 3 local vertex indices per triangle
+		uint32_t vertexCount{};
+		uint32_t triangleCount{};
+	};
+
+	// One level of detail of a Mesh, its triangles and meshlets are ranges in the mesh's streams
+	struct MeshLod
+	{
+		uint32_t indexOffset{};
+		uint32_t indexCount{};
+		uint32_t meshletOffset{};
+		uint32_t meshletCount{};
+		// Largest distance between this level and the full mesh, in object space
+		float error{};
+	};
+
+	constexpr uint32_t MAX_MESH_LODS{ 4 };
+
 	enum class PrimitiveTopology
 	{
 		TriangleList,
@@ -80,6 +241,106 @@ namespace dae
 
 		std::vector<Vertex_Out> vertices_out{};
 		Matrix worldMatrix{};
+
+		// Object space bounds, see UpdateBounds
+		AABB bounds{};
+
+		// Optional clusters of a triangle list, lets the renderer cull parts of a mesh before transforming them
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{};
+		std::vector<uint8_t> meshletTriangles{};
+
+		// Optional simplified versions, finest first. Every level shares the vertices, see MeshSimplifier
+		std::vector<MeshLod> lods{};
+
+		// Set when the vertex/index/meshlet data lives in a memory mapped mesh cache instead of the vectors above
+		std::shared_ptr<const MappedFile> pMappedFile{};
+		std::span<const Vertex> mappedVertices{};
+		std::span<const uint32_t> mappedIndices{};
+		std::span<const Meshlet> mappedMeshlets{};
+		std::span<const uint32_t> mappedMeshletVertices{};
+		std::span<const uint8_t> mappedMeshletTriangles{};
+		std::span<const MeshLod> mappedLods{};
+
+		// Optional compact vertex stream, the renderer prefers it over the full vertices when present
+		std::vector<PackedVertex> packedVertices{};
+		VertexQuantization quantization{};
+
+		// Draw from these, they work for both owned and mapped storage
+		std::span<const Vertex> GetVertices() const
+		{
+			if (pMappedFile)
+				return mappedVertices;
+			return vertices;
+		}
+
+		std::span<const uint32_t> GetIndices() const
+		{
+			if (pMappedFile)
+				return mappedIndices;
+			return indices;
+		}
+
+		std::span<const Meshlet> GetMeshlets() const
+		{
+			if (pMappedFile)
+				return mappedMeshlets;
+			return meshlets;
+		}
+
+		std::span<const uint32_t> GetMeshletVertices() const
+		{
+			if (pMappedFile)
+				return mappedMeshletVertices;
+			return meshletVertices;
+		}
+
+		std::span<const uint8_t> GetMeshletTriangles() const
+		{
+			if (pMappedFile)
+				return mappedMeshletTriangles;
+			return meshletTriangles;
+		}
+
+		std::span<const MeshLod> GetLods() const
+		{
+			if (pMappedFile)
+				return mappedLods;
+			return lods;
+		}
+
+		// A mesh without LODs is its own LOD 0
+		size_t GetNrLods() const
+		{
+			return std::max(GetLods().size(), size_t{ 1 });
+		}
+
+		std::span<const uint32_t> GetLodIndices(size_t lodIdx) const
+		{
+			const std::span<const MeshLod> meshLods{ GetLods() };
+			if (meshLods.empty())
+				return GetIndices();
+			return GetIndices().subspan(meshLods[lodIdx].indexOffset, meshLods[lodIdx].indexCount);
+		}
+
+		std::span<const Meshlet> GetLodMeshlets(size_t lodIdx) const
+		{
+			const std::span<const MeshLod> meshLods{ GetLods() };
+			if (meshLods.empty())
+				return GetMeshlets();
+			return GetMeshlets().subspan(meshLods[lodIdx].meshletOffset, meshLods[lodIdx].meshletCount);
+		}
+
+		// Uses the full vertices, or the quantization range once only packed vertices are left
+		void UpdateBounds()
+		{
+			bounds = {};
+			for (const Vertex& vertex : GetVertices())
+				bounds.Grow(vertex.position);
+
+			if (!bounds.IsValid() && !packedVertices.empty())
+				bounds = { quantization.offset, quantization.offset + quantization.scale * 65535.f };
+		}
 	};
 
 	struct TriangleMesh
@@ -0,0 +1,46 @@
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <array>
+
+using namespace dae;
+
+void DrawQueue::Submit(uint32_t instanceIdx, uint32_t group, float depth)
+{
+	constexpr uint32_t depthBits{ 24 };
+	constexpr uint32_t maxDepth{ (1u << depthBits) - 1 };
+
+	const uint32_t quantizedDepth{ static_cast<uint32_t>(std::clamp(depth, 0.f, 1.f) * maxDepth) };
+	const uint32_t key{ ((group & 0xff) << depthBits) | quantizedDepth };
+
+	m_Draws.push_back(uint64_t{ key } << 32 | instanceIdx);
+}
+
+void DrawQueue::Sort()
+{
+	const size_t nrDraws{ m_Draws.size() };
+	m_SortBuffer.resize(nrDraws);
+
+	// Only the key half takes part, the instance index rides along
+	for (uint32_t shift{ 32 }; shift < 64; shift += 8)
+	{
+		std::array<uint32_t, 256> offsets{};
+		for (const uint64_t draw : m_Draws)
+			++offsets[(draw >> shift) & 0xff];
+
+		if (std::find(offsets.begin(), offsets.end(), static_cast<uint32_t>(nrDraws)) != offsets.end())
+			continue;
+
+		uint32_t offset{};
+		for (uint32_t& bucket : offsets)
+		{
+			const uint32_t count{ bucket };
+			bucket = offset;
+			offset += count;
+		}
+
+		for (const uint64_t draw : m_Draws)
+			m_SortBuffer[offsets[(draw >> shift) & 0xff]++] = draw;
+		m_Draws.swap(m_SortBuffer);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	// Opaque draws of one frame, sorted on 32-bit keys: [group : 8][depth : 24].
+	// Lower keys draw first, so with the depth in the low bits every group comes out front-to-back
+	class DrawQueue final
+	{
+	public:
+		DrawQueue() = default;
+		~DrawQueue() = default;
+
+		DrawQueue(const DrawQueue&) = delete;
+		DrawQueue(DrawQueue&&) noexcept = delete;
+		DrawQueue& operator=(const DrawQueue&) = delete;
+		DrawQueue& operator=(DrawQueue&&) noexcept = delete;
+
+		void Clear() { m_Draws.clear(); }
+
+		// depth is 0 at the near plane and 1 at the far plane, anything outside gets clamped.
+		// Only the lowest 8 bits of group are used
+		void Submit(uint32_t instanceIdx, uint32_t group, float depth);
+
+		// Stable LSD radix sort, 8 bits per pass, passes where every key has the same byte are skipped
+		void Sort();
+
+		size_t GetSize() const { return m_Draws.size(); }
+		// Instance index of the idx-th draw
+		uint32_t operator[](size_t idx) const { return static_cast<uint32_t>(m_Draws[idx]); }
+
+	private:
+		// Key in the high half, instance index in the low half
+		std::vector<uint64_t> m_Draws{};
+		std::vector<uint64_t> m_SortBuffer{};
+	};
+}
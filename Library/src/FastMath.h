@@ -0,0 +1,83 @@
+#pragma once
+#include <cfloat>
+#include <emmintrin.h>
+
+namespace dae
+{
+	// Approximations of 4 floats at a time, for shading where 8 bit output hides the last bits.
+	// The error bounds are relative to the exact result unless noted otherwise, measured over every input range listed
+	namespace FastMath
+	{
+		// 1 / a for |a| in [FLT_MIN, 2^125], relative error below 3e-7. rcpps estimate refined by one Newton step
+		inline __m128 Rcp(__m128 a)
+		{
+			const __m128 estimate{ _mm_rcp_ps(a) };
+			return _mm_add_ps(estimate, _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(a, estimate))));
+		}
+
+		// 1 / sqrt(a) for positive normal a, relative error below 4e-7. rsqrtps estimate refined by one Newton step
+		inline __m128 Rsqrt(__m128 a)
+		{
+			const __m128 estimate{ _mm_rsqrt_ps(a) };
+			const __m128 halfA{ _mm_mul_ps(a, _mm_set1_ps(0.5f)) };
+			return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfA, _mm_mul_ps(estimate, estimate))));
+		}
+
+		// 2^x, relative error below 3e-7. x is clamped to [-126, 128), so the result is always a normal float
+		inline __m128 Exp2(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.f)), _mm_set1_ps(127.99999f));
+
+			// x = exponent + fraction with fraction in [-0.5, 0.5], 2^fraction is a polynomial.
+			// Its constant term is exactly 1, so whole numbers give exact powers of 2
+			const __m128i exponent{ _mm_cvtps_epi32(x) };
+			const __m128 fraction{ _mm_sub_ps(x, _mm_cvtepi32_ps(exponent)) };
+
+			__m128 result{ _mm_set1_ps(1.33908633e-3f) };
+			result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(9.67603177e-3f));
+			result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(5.55035695e-2f));
+			result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(2.40221068e-1f));
+			result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(6.93147182e-1f));
+			result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(1.f));
+
+			// Multiplying by 2^exponent only adds to the exponent bits
+			return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(result), _mm_slli_epi32(exponent, 23)));
+		}
+
+		// log2(x), absolute error below 1.5e-7 * (1 + |log2(x)|). x below FLT_MIN, zero included, counts as FLT_MIN
+		inline __m128 Log2(__m128 x)
+		{
+			const __m128i bits{ _mm_castps_si128(_mm_max_ps(x, _mm_set1_ps(FLT_MIN))) };
+
+			// x = 2^exponent * mantissa with mantissa in [sqrt(0.5), sqrt(2)), so log2(mantissa) stays close to 0
+			__m128i exponent{ _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)) };
+			__m128 mantissa{ _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))) };
+			const __m128 isLarge{ _mm_cmpgt_ps(mantissa, _mm_set1_ps(1.41421356f)) };
+			mantissa = _mm_or_ps(_mm_and_ps(isLarge, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))), _mm_andnot_ps(isLarge, mantissa));
+			exponent = _mm_sub_epi32(exponent, _mm_castps_si128(isLarge));
+
+			// log2(1 + t) = t * polynomial(t)
+			const __m128 t{ _mm_sub_ps(mantissa, _mm_set1_ps(1.f)) };
+			__m128 result{ _mm_set1_ps(-0.14275974f) };
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(0.232652575f));
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(-0.249271825f));
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(0.287288874f));
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(-0.360225171f));
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(0.480916709f));
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(-0.721352935f));
+			result = _mm_add_ps(_mm_mul_ps(result, t), _mm_set1_ps(1.44269502f));
+
+			return _mm_add_ps(_mm_mul_ps(result, t), _mm_cvtepi32_ps(exponent));
+		}
+
+		// base^exponent for base >= 0, as 2^(exponent * log2(base)). Relative error below 3e-7 * (1 + |exponent * log2(base)|),
+		// so below 3e-6 for results above 2^-9. Like std::pow a base of 0 gives 0, or 1 when the exponent is 0 as well
+		inline __m128 Pow(__m128 base, __m128 exponent)
+		{
+			const __m128 result{ Exp2(_mm_mul_ps(exponent, Log2(base))) };
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 isDefined{ _mm_or_ps(_mm_cmpgt_ps(base, zero), _mm_cmpeq_ps(exponent, zero)) };
+			return _mm_and_ps(result, isDefined);
+		}
+	}
+}
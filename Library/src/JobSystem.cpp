@@ -0,0 +1,164 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+namespace
+{
+	// 0 on every thread outside the pool
+	thread_local uint32_t g_QueueIdx{};
+}
+
+JobSystem::JobSystem()
+{
+	const uint32_t nrWorkers{ std::max(std::thread::hardware_concurrency(), 2u) - 1 };
+
+	for (uint32_t idx{}; idx <= nrWorkers; ++idx)
+		m_Queues.push_back(std::make_unique<WorkQueue>());
+
+	m_Workers.reserve(nrWorkers);
+	for (uint32_t idx{ 1 }; idx <= nrWorkers; ++idx)
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, idx);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::scoped_lock lock{ m_SleepMutex };
+		m_IsQuitting = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+JobSystem& JobSystem::GetInstance()
+{
+	static JobSystem jobSystem{};
+	return jobSystem;
+}
+
+void JobSystem::Run(JobCounter& counter, std::function<void()> function)
+{
+	counter.m_NrJobs.fetch_add(1, std::memory_order_relaxed);
+	Push({ std::move(function), &counter });
+}
+
+void JobSystem::Run(JobCounter& counter, std::function<void()> function, JobCounter& dependency)
+{
+	counter.m_NrJobs.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::scoped_lock lock{ dependency.m_Mutex };
+		if (dependency.m_NrJobs.load(std::memory_order_acquire) > 0)
+		{
+			dependency.m_Dependents.push_back({ std::move(function), &counter });
+			return;
+		}
+	}
+	Push({ std::move(function), &counter });
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	const uint32_t queueIdx{ g_QueueIdx };
+	while (!counter.IsDone())
+	{
+		if (!TryRunJob(queueIdx))
+			std::this_thread::yield();
+	}
+
+	// The last job may still be releasing the counter's mutex
+	std::scoped_lock lock{ counter.m_Mutex };
+}
+
+void JobSystem::WorkerLoop(uint32_t queueIdx)
+{
+	g_QueueIdx = queueIdx;
+
+	while (true)
+	{
+		if (TryRunJob(queueIdx))
+			continue;
+
+		std::unique_lock lock{ m_SleepMutex };
+		m_WakeCondition.wait(lock, [this]() { return m_IsQuitting || m_NrQueuedJobs.load() > 0; });
+		if (m_IsQuitting)
+			return;
+	}
+}
+
+void JobSystem::Push(Job&& job)
+{
+	// Counted before it is queued so the count never drops below zero. Taking the sleep mutex makes sure
+	// no worker is between checking the count and going to sleep
+	{
+		std::scoped_lock lock{ m_SleepMutex };
+		m_NrQueuedJobs.fetch_add(1);
+	}
+
+	WorkQueue& queue{ *m_Queues[g_QueueIdx] };
+	{
+		std::scoped_lock lock{ queue.mutex };
+		queue.jobs.push_back(std::move(job));
+	}
+	m_WakeCondition.notify_one();
+}
+
+bool JobSystem::TryRunJob(uint32_t queueIdx)
+{
+	if (m_NrQueuedJobs.load(std::memory_order_relaxed) == 0)
+		return false;
+
+	Job job{};
+	bool hasJob{ false };
+
+	// Newest job of our own queue first, it is the most likely to still be in cache
+	{
+		WorkQueue& queue{ *m_Queues[queueIdx] };
+		std::scoped_lock lock{ queue.mutex };
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			hasJob = true;
+		}
+	}
+
+	// Otherwise steal the oldest job of another queue, that is usually the biggest piece of work left
+	const uint32_t nrQueues{ static_cast<uint32_t>(m_Queues.size()) };
+	for (uint32_t offset{ 1 }; !hasJob && offset < nrQueues; ++offset)
+	{
+		WorkQueue& queue{ *m_Queues[(queueIdx + offset) % nrQueues] };
+		std::scoped_lock lock{ queue.mutex };
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			hasJob = true;
+		}
+	}
+
+	if (!hasJob)
+		return false;
+
+	m_NrQueuedJobs.fetch_sub(1);
+	job.function();
+	Finish(*job.pCounter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter& counter)
+{
+	std::vector<JobCounter::Dependent> dependents{};
+	{
+		std::scoped_lock lock{ counter.m_Mutex };
+		if (counter.m_NrJobs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			dependents.swap(counter.m_Dependents);
+	}
+
+	// The counter may be gone by now, its dependents were already counted in their own counters
+	for (JobCounter::Dependent& dependent : dependents)
+		Push({ std::move(dependent.function), dependent.pCounter });
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	// Number of jobs still to finish, shared by every job started with it.
+	// Jobs can also be started after a counter, they stay off the queues until it reaches zero
+	class JobCounter final
+	{
+	public:
+		JobCounter() = default;
+		~JobCounter() = default;
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter(JobCounter&&) noexcept = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+		JobCounter& operator=(JobCounter&&) noexcept = delete;
+
+		bool IsDone() const { return m_NrJobs.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		struct Dependent
+		{
+			std::function<void()> function{};
+			JobCounter* pCounter{};
+		};
+
+		std::atomic<uint32_t> m_NrJobs{};
+		// Guards the dependents and the last decrement, so a finished counter is no longer touched by any worker
+		mutable std::mutex m_Mutex{};
+		std::vector<Dependent> m_Dependents{};
+	};
+
+	// Work-stealing thread pool: every thread has its own deque, it pops its newest job and steals the oldest job of the others.
+	// Threads that are not workers (the main thread) share one extra deque. Waiting on a counter runs other jobs instead of blocking
+	class JobSystem final
+	{
+	public:
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		// One pool for the whole program, with a worker for every hardware thread but the main one
+		static JobSystem& GetInstance();
+
+		uint32_t GetNrThreads() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+		void Run(JobCounter& counter, std::function<void()> function);
+		// Queues function once dependency is done
+		void Run(JobCounter& counter, std::function<void()> function, JobCounter& dependency);
+
+		// Runs queued jobs on the calling thread until counter is done
+		void Wait(const JobCounter& counter);
+
+		// Calls function(begin, end) for chunks of [0, count) and returns when all of them are done
+		template<typename RangeFunction>
+		void ParallelFor(uint32_t count, uint32_t chunkSize, const RangeFunction& function);
+
+	private:
+		struct Job
+		{
+			std::function<void()> function{};
+			JobCounter* pCounter{};
+		};
+
+		struct WorkQueue
+		{
+			std::mutex mutex{};
+			std::deque<Job> jobs{};
+		};
+
+		JobSystem();
+
+		void WorkerLoop(uint32_t queueIdx);
+		void Push(Job&& job);
+		bool TryRunJob(uint32_t queueIdx);
+		void Finish(JobCounter& counter);
+
+		// Queue 0 belongs to the threads outside the pool, queue i to worker i
+		std::vector<std::unique_ptr<WorkQueue>> m_Queues{};
+		std::vector<std::thread> m_Workers{};
+
+		std::atomic<uint32_t> m_NrQueuedJobs{};
+		std::mutex m_SleepMutex{};
+		std::condition_variable m_WakeCondition{};
+		bool m_IsQuitting{ false };
+	};
+
+	template<typename RangeFunction>
+	void JobSystem::ParallelFor(uint32_t count, uint32_t chunkSize, const RangeFunction& function)
+	{
+		if (count <= chunkSize)
+		{
+			if (count > 0)
+				function(0u, count);
+			return;
+		}
+
+		JobCounter counter{};
+		for (uint32_t begin{}; begin < count; begin += chunkSize)
+		{
+			const uint32_t end{ std::min(begin + chunkSize, count) };
+			Run(counter, [&function, begin, end]() { function(begin, end); });
+		}
+		Wait(counter);
+	}
+}
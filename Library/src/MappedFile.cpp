@@ -0,0 +1,90 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+	MappedFile::~MappedFile()
+	{
+#ifdef _WIN32
+		if (m_pData)
+			UnmapViewOfFile(m_pData);
+		if (m_MappingHandle)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+#else
+		if (m_pData)
+			munmap(const_cast<uint8_t*>(m_pData), m_Size);
+#endif
+	}
+
+	MappedFile* MappedFile::Open(const std::string& path)
+	{
+		MappedFile* pFile{ new MappedFile() };
+
+#ifdef _WIN32
+		const HANDLE fileHandle{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			delete pFile;
+			return nullptr;
+		}
+		pFile->m_FileHandle = fileHandle;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		{
+			delete pFile;
+			return nullptr;
+		}
+		pFile->m_Size = static_cast<size_t>(fileSize.QuadPart);
+
+		pFile->m_MappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!pFile->m_MappingHandle)
+		{
+			delete pFile;
+			return nullptr;
+		}
+
+		pFile->m_pData = static_cast<const uint8_t*>(MapViewOfFile(pFile->m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+		const int fileDescriptor{ open(path.c_str(), O_RDONLY) };
+		if (fileDescriptor < 0)
+		{
+			delete pFile;
+			return nullptr;
+		}
+
+		struct stat fileStats {};
+		if (fstat(fileDescriptor, &fileStats) == 0 && fileStats.st_size > 0)
+		{
+			pFile->m_Size = static_cast<size_t>(fileStats.st_size);
+
+			void* pData{ mmap(nullptr, pFile->m_Size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) };
+			if (pData != MAP_FAILED)
+				pFile->m_pData = static_cast<const uint8_t*>(pData);
+		}
+
+		// The mapping stays valid after the descriptor is closed
+		close(fileDescriptor);
+#endif
+
+		if (!pFile->m_pData)
+		{
+			delete pFile;
+			return nullptr;
+		}
+
+		return pFile;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	// Read-only memory mapping of a whole file
+	class MappedFile final
+	{
+	public:
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		// Returns nullptr when the file does not exist, is empty or can't be mapped
+		static MappedFile* Open(const std::string& path);
+
+		const uint8_t* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		MappedFile() = default;
+
+		const uint8_t* m_pData{ nullptr };
+		size_t m_Size{};
+
+		// Win32 handles, unused on POSIX where the descriptor is closed after mapping
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+	};
+}
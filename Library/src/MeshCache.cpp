@@ -0,0 +1,209 @@
+#include "MeshCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		uint64_t AlignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		void WritePadding(std::ofstream& file, uint64_t from, uint64_t to)
+		{
+			constexpr char zeros[MeshCache::STREAM_ALIGNMENT]{};
+			file.write(zeros, static_cast<std::streamsize>(to - from));
+		}
+
+		template<typename T>
+		bool IsValidStream(uint64_t offset, uint32_t count, uint64_t fileSize)
+		{
+			return offset % alignof(T) == 0 && offset + uint64_t{ count } * sizeof(T) <= fileSize;
+		}
+
+		template<typename T>
+		std::span<const T> GetStream(const MappedFile& file, uint64_t offset, uint32_t count)
+		{
+			return { reinterpret_cast<const T*>(file.GetData() + offset), count };
+		}
+	}
+
+	uint64_t MeshCache::HashBytes(const uint8_t* pData, size_t size)
+	{
+		uint64_t hash{ 0xcbf29ce484222325 };
+		for (size_t idx{}; idx < size; ++idx)
+		{
+			hash ^= pData[idx];
+			hash *= 0x100000001b3;
+		}
+		return hash;
+	}
+
+	std::string MeshCache::GetCachePath(const std::string& objPath)
+	{
+		return std::filesystem::path{ objPath }.replace_extension(".mesh").string();
+	}
+
+	bool MeshCache::LoadOBJ(const std::string& objPath, Mesh& mesh, bool flipAxisAndWinding)
+	{
+		uint64_t sourceHash{};
+		{
+			const std::unique_ptr<MappedFile> pSource{ MappedFile::Open(objPath) };
+			if (!pSource)
+				return false;
+			sourceHash = HashBytes(pSource->GetData(), pSource->GetSize());
+		}
+
+		const uint32_t flags{ flipAxisAndWinding ? FLAG_FLIP_AXIS_AND_WINDING : 0u };
+		const std::string cachePath{ GetCachePath(objPath) };
+
+		mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+
+		if (Map(cachePath, mesh, sourceHash, flags))
+			return true;
+
+		if (!Utils::ParseOBJ(objPath, mesh.vertices, mesh.indices, flipAxisAndWinding))
+			return false;
+
+		// Baked into the cache, so this only runs on the first import
+		const MeshOptimizer::OptimizationReport report{ MeshOptimizer::Optimize(mesh.vertices, mesh.indices) };
+		std::cout << objPath << " vertex cache optimized: ACMR " << report.before.acmr << " -> " << report.after.acmr
+			<< ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+
+		MeshSimplifier::GenerateLods(mesh.vertices, mesh.indices, mesh.lods);
+		std::cout << objPath << " LOD triangles:";
+		for (const MeshLod& lod : mesh.lods)
+			std::cout << ' ' << lod.indexCount / 3;
+		std::cout << std::endl;
+
+		// Every LOD gets its own meshlets so the coarse levels are culled just as finely
+		for (MeshLod& lod : mesh.lods)
+		{
+			lod.meshletOffset = static_cast<uint32_t>(mesh.meshlets.size());
+			MeshletBuilder::Build(mesh.vertices, std::span<const uint32_t>{ mesh.indices }.subspan(lod.indexOffset, lod.indexCount),
+				mesh.meshlets, mesh.meshletVertices, mesh.meshletTriangles);
+			lod.meshletCount = static_cast<uint32_t>(mesh.meshlets.size()) - lod.meshletOffset;
+		}
+		std::cout << objPath << " split into " << mesh.meshlets.size() << " meshlets" << std::endl;
+
+		// Failing to write only costs a re-parse next launch
+		Write(cachePath, mesh, sourceHash, flags);
+		return true;
+	}
+
+	bool MeshCache::Write(const std::string& cachePath, const Mesh& mesh, uint64_t sourceHash, uint32_t flags)
+	{
+		const std::span<const Vertex> vertices{ mesh.GetVertices() };
+		const std::span<const uint32_t> indices{ mesh.GetIndices() };
+		const std::span<const Meshlet> meshlets{ mesh.GetMeshlets() };
+		const std::span<const uint32_t> meshletVertices{ mesh.GetMeshletVertices() };
+		const std::span<const uint8_t> meshletTriangles{ mesh.GetMeshletTriangles() };
+		const std::span<const MeshLod> lods{ mesh.GetLods() };
+
+		MeshCacheHeader header{};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.sourceHash = sourceHash;
+		header.vertexStride = sizeof(Vertex);
+		header.vertexCount = static_cast<uint32_t>(vertices.size());
+		header.indexCount = static_cast<uint32_t>(indices.size());
+		header.flags = flags;
+		header.meshletStride = sizeof(Meshlet);
+		header.meshletCount = static_cast<uint32_t>(meshlets.size());
+		header.meshletVertexCount = static_cast<uint32_t>(meshletVertices.size());
+		header.meshletTriangleCount = static_cast<uint32_t>(meshletTriangles.size());
+		header.lodStride = sizeof(MeshLod);
+		header.lodCount = static_cast<uint32_t>(lods.size());
+		header.vertexOffset = AlignUp(sizeof(MeshCacheHeader), STREAM_ALIGNMENT);
+		header.indexOffset = AlignUp(header.vertexOffset + vertices.size_bytes(), STREAM_ALIGNMENT);
+		header.meshletOffset = AlignUp(header.indexOffset + indices.size_bytes(), STREAM_ALIGNMENT);
+		header.meshletVertexOffset = AlignUp(header.meshletOffset + meshlets.size_bytes(), STREAM_ALIGNMENT);
+		header.meshletTriangleOffset = AlignUp(header.meshletVertexOffset + meshletVertices.size_bytes(), STREAM_ALIGNMENT);
+		header.lodOffset = AlignUp(header.meshletTriangleOffset + meshletTriangles.size_bytes(), STREAM_ALIGNMENT);
+
+		// Write to a temporary file first so a crash never leaves a truncated cache behind
+		const std::string tempPath{ cachePath + ".tmp" };
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			if (!file)
+				return false;
+
+			uint64_t position{};
+			const auto writeStream = [&](uint64_t offset, const void* pData, size_t size)
+			{
+				WritePadding(file, position, offset);
+				file.write(reinterpret_cast<const char*>(pData), static_cast<std::streamsize>(size));
+				position = offset + size;
+			};
+
+			writeStream(0, &header, sizeof(header));
+			writeStream(header.vertexOffset, vertices.data(), vertices.size_bytes());
+			writeStream(header.indexOffset, indices.data(), indices.size_bytes());
+			writeStream(header.meshletOffset, meshlets.data(), meshlets.size_bytes());
+			writeStream(header.meshletVertexOffset, meshletVertices.data(), meshletVertices.size_bytes());
+			writeStream(header.meshletTriangleOffset, meshletTriangles.data(), meshletTriangles.size_bytes());
+			writeStream(header.lodOffset, lods.data(), lods.size_bytes());
+
+			if (!file)
+				return false;
+		}
+
+		std::error_code error{};
+		std::filesystem::rename(tempPath, cachePath, error);
+		return !error;
+	}
+
+	bool MeshCache::Map(const std::string& cachePath, Mesh& mesh, uint64_t sourceHash, uint32_t flags)
+	{
+		const std::shared_ptr<const MappedFile> pFile{ MappedFile::Open(cachePath) };
+		if (!pFile || pFile->GetSize() < sizeof(MeshCacheHeader))
+			return false;
+
+		const MeshCacheHeader& header{ *reinterpret_cast<const MeshCacheHeader*>(pFile->GetData()) };
+		const uint64_t fileSize{ pFile->GetSize() };
+		const bool isValid{
+			header.magic == MAGIC &&
+			header.version == VERSION &&
+			header.sourceHash == sourceHash &&
+			header.vertexStride == sizeof(Vertex) &&
+			header.meshletStride == sizeof(Meshlet) &&
+			header.lodStride == sizeof(MeshLod) &&
+			header.flags == flags &&
+			IsValidStream<Vertex>(header.vertexOffset, header.vertexCount, fileSize) &&
+			IsValidStream<uint32_t>(header.indexOffset, header.indexCount, fileSize) &&
+			IsValidStream<Meshlet>(header.meshletOffset, header.meshletCount, fileSize) &&
+			IsValidStream<uint32_t>(header.meshletVertexOffset, header.meshletVertexCount, fileSize) &&
+			IsValidStream<uint8_t>(header.meshletTriangleOffset, header.meshletTriangleCount, fileSize) &&
+			IsValidStream<MeshLod>(header.lodOffset, header.lodCount, fileSize)
+		};
+		if (!isValid)
+			return false;
+
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		mesh.meshlets.clear();
+		mesh.meshletVertices.clear();
+		mesh.meshletTriangles.clear();
+		mesh.lods.clear();
+		mesh.mappedVertices = GetStream<Vertex>(*pFile, header.vertexOffset, header.vertexCount);
+		mesh.mappedIndices = GetStream<uint32_t>(*pFile, header.indexOffset, header.indexCount);
+		mesh.mappedMeshlets = GetStream<Meshlet>(*pFile, header.meshletOffset, header.meshletCount);
+		mesh.mappedMeshletVertices = GetStream<uint32_t>(*pFile, header.meshletVertexOffset, header.meshletVertexCount);
+		mesh.mappedMeshletTriangles = GetStream<uint8_t>(*pFile, header.meshletTriangleOffset, header.meshletTriangleCount);
+		mesh.mappedLods = GetStream<MeshLod>(*pFile, header.lodOffset, header.lodCount);
+		mesh.pMappedFile = pFile;
+		return true;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	struct Mesh;
+
+	namespace MeshCache
+	{
+		// Layout of a .mesh file, everything is little endian and in native Vertex/Meshlet layout,
+		// every stream starts at a STREAM_ALIGNMENT boundary:
+		// [MeshCacheHeader][Vertex * vertexCount][uint32_t * indexCount]
+		// [Meshlet * meshletCount][uint32_t * meshletVertexCount][uint8_t * meshletTriangleCount][MeshLod * lodCount]
+		struct MeshCacheHeader
+		{
+			uint32_t magic{};
+			uint32_t version{};
+			uint64_t sourceHash{};
+			uint32_t vertexStride{};
+			uint32_t vertexCount{};
+			uint32_t indexCount{};
+			uint32_t flags{};
+			uint64_t vertexOffset{};
+			uint64_t indexOffset{};
+			uint32_t meshletStride{};
+			uint32_t meshletCount{};
+			uint32_t meshletVertexCount{};
+			uint32_t meshletTriangleCount{};
+			uint64_t meshletOffset{};
+			uint64_t meshletVertexOffset{};
+			uint64_t meshletTriangleOffset{};
+			uint32_t lodStride{};
+			uint32_t lodCount{};
+			uint64_t lodOffset{};
+			uint8_t padding[24]{};
+		};
+		static_assert(sizeof(MeshCacheHeader) == 128);
+
+		constexpr uint32_t MAGIC{ 0x4d454144 }; // "DAEM"
+		// Bump whenever Vertex or the import pipeline changes so stale caches are rebuilt
+		constexpr uint32_t VERSION{ 5 };
+		constexpr uint64_t STREAM_ALIGNMENT{ 64 };
+
+		constexpr uint32_t FLAG_FLIP_AXIS_AND_WINDING{ 1 << 0 };
+
+		// 64-bit FNV-1a
+		uint64_t HashBytes(const uint8_t* pData, size_t size);
+
+		std::string GetCachePath(const std::string& objPath);
+
+		// Maps the cache next to objPath if it is still valid, otherwise parses the OBJ and writes a fresh cache.
+		// A mapped mesh points its vertex/index/meshlet views straight into the file, see Mesh::GetVertices
+		bool LoadOBJ(const std::string& objPath, Mesh& mesh, bool flipAxisAndWinding = true);
+
+		bool Write(const std::string& cachePath, const Mesh& mesh, uint64_t sourceHash, uint32_t flags);
+		bool Map(const std::string& cachePath, Mesh& mesh, uint64_t sourceHash, uint32_t flags);
+	}
+}
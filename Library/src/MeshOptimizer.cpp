@@ -0,0 +1,338 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace
+	{
+		// FIFO cache simulation, timestamps avoid having to shift an actual queue
+		class FifoCache final
+		{
+		public:
+			FifoCache(size_t nrVertices, uint32_t cacheSize)
+				: m_Timestamps(nrVertices, 0)
+				, m_CacheSize{ cacheSize }
+				, m_Time{ cacheSize + 1 }
+			{
+			}
+
+			// Returns true on a miss
+			bool Access(uint32_t vertexIdx)
+			{
+				if (m_Time - m_Timestamps[vertexIdx] <= m_CacheSize)
+					return false;
+
+				m_Timestamps[vertexIdx] = m_Time++;
+				return true;
+			}
+
+			// Evicts everything by moving time past the cache size
+			void Flush()
+			{
+				m_Time += m_CacheSize + 1;
+			}
+
+		private:
+			std::vector<uint32_t> m_Timestamps;
+			uint32_t m_CacheSize;
+			uint32_t m_Time;
+		};
+
+		struct Adjacency
+		{
+			std::vector<uint32_t> offsets{};
+			std::vector<uint32_t> triangles{};
+			std::vector<uint32_t> liveCounts{};
+		};
+
+		Adjacency BuildAdjacency(const std::vector<uint32_t>& indices, size_t nrVertices)
+		{
+			Adjacency adjacency{};
+			adjacency.liveCounts.resize(nrVertices, 0);
+			for (const uint32_t index : indices)
+				++adjacency.liveCounts[index];
+
+			adjacency.offsets.resize(nrVertices + 1, 0);
+			for (size_t idx{}; idx < nrVertices; ++idx)
+				adjacency.offsets[idx + 1] = adjacency.offsets[idx] + adjacency.liveCounts[idx];
+
+			adjacency.triangles.resize(indices.size());
+			std::vector<uint32_t> fillOffsets{ adjacency.offsets.begin(), adjacency.offsets.end() - 1 };
+			for (uint32_t idx{}; idx < indices.size(); ++idx)
+				adjacency.triangles[fillOffsets[indices[idx]]++] = idx / 3;
+
+			return adjacency;
+		}
+
+		// Misses for the triangles [triBegin, triEnd), continuing from the current cache state
+		uint32_t CountMisses(const std::vector<uint32_t>& indices, uint32_t triBegin, uint32_t triEnd, FifoCache& cache)
+		{
+			uint32_t misses{};
+			for (uint32_t idx{ triBegin * 3 }; idx < triEnd * 3; ++idx)
+				misses += cache.Access(indices[idx]);
+			return misses;
+		}
+	}
+
+	MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t nrVertices, uint32_t cacheSize)
+	{
+		if (indices.empty() || nrVertices == 0)
+			return {};
+
+		FifoCache cache{ nrVertices, cacheSize };
+		const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+		const uint32_t misses{ CountMisses(indices, 0, nrTriangles, cache) };
+
+		// Only count vertices that are actually referenced
+		std::vector<bool> isUsed(nrVertices, false);
+		for (const uint32_t index : indices)
+			isUsed[index] = true;
+		const size_t nrUsedVertices{ static_cast<size_t>(std::count(isUsed.begin(), isUsed.end(), true)) };
+
+		return { static_cast<float>(misses) / nrTriangles, static_cast<float>(misses) / nrUsedVertices };
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices, std::vector<uint32_t>& clusterOffsets, uint32_t cacheSize)
+	{
+		clusterOffsets.clear();
+
+		const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+		if (nrTriangles == 0)
+			return;
+
+		Adjacency adjacency{ BuildAdjacency(indices, nrVertices) };
+		std::vector<uint32_t>& liveCounts{ adjacency.liveCounts };
+
+		std::vector<uint32_t> cacheTimestamps(nrVertices, 0);
+		std::vector<bool> isEmitted(nrTriangles, false);
+		std::vector<uint32_t> deadEndStack{};
+		std::vector<uint32_t> candidates{};
+
+		std::vector<uint32_t> triangleOrder{};
+		triangleOrder.reserve(nrTriangles);
+		std::vector<uint32_t> hardBoundaries{ 0 };
+
+		uint32_t time{ cacheSize + 1 };
+		uint32_t inputCursor{};
+
+		// Next vertex in input order that still has triangles left, or the top of the dead-end stack
+		const auto skipDeadEnd = [&]() -> int64_t
+		{
+			while (!deadEndStack.empty())
+			{
+				const uint32_t vertexIdx{ deadEndStack.back() };
+				deadEndStack.pop_back();
+				if (liveCounts[vertexIdx] > 0)
+					return vertexIdx;
+			}
+
+			while (inputCursor < nrVertices)
+			{
+				if (liveCounts[inputCursor] > 0)
+					return inputCursor;
+				++inputCursor;
+			}
+
+			return -1;
+		};
+
+		int64_t fanningVertex{ skipDeadEnd() };
+		while (fanningVertex >= 0)
+		{
+			candidates.clear();
+
+			// Emit every remaining triangle around the fanning vertex
+			for (uint32_t idx{ adjacency.offsets[fanningVertex] }; idx < adjacency.offsets[fanningVertex + 1]; ++idx)
+			{
+				const uint32_t triIdx{ adjacency.triangles[idx] };
+				if (isEmitted[triIdx])
+					continue;
+
+				for (uint32_t corner{}; corner < 3; ++corner)
+				{
+					const uint32_t vertexIdx{ indices[triIdx * 3 + corner] };
+					deadEndStack.push_back(vertexIdx);
+					candidates.push_back(vertexIdx);
+					--liveCounts[vertexIdx];
+
+					if (time - cacheTimestamps[vertexIdx] > cacheSize)
+						cacheTimestamps[vertexIdx] = time++;
+				}
+
+				isEmitted[triIdx] = true;
+				triangleOrder.push_back(triIdx);
+			}
+
+			// Pick the candidate that is still in cache after its remaining triangles get emitted, oldest first
+			int64_t nextVertex{ -1 };
+			int64_t bestPriority{ -1 };
+			for (const uint32_t vertexIdx : candidates)
+			{
+				if (liveCounts[vertexIdx] == 0)
+					continue;
+
+				int64_t priority{ 0 };
+				const int64_t age{ static_cast<int64_t>(time) - cacheTimestamps[vertexIdx] };
+				if (age + 2 * static_cast<int64_t>(liveCounts[vertexIdx]) <= cacheSize)
+					priority = age;
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					nextVertex = vertexIdx;
+				}
+			}
+
+			if (nextVertex < 0)
+			{
+				// Dead end, the cache effectively restarts here
+				nextVertex = skipDeadEnd();
+				if (nextVertex >= 0 && triangleOrder.size() != hardBoundaries.back())
+					hardBoundaries.push_back(static_cast<uint32_t>(triangleOrder.size()));
+			}
+
+			fanningVertex = nextVertex;
+		}
+
+		std::vector<uint32_t> reordered(indices.size());
+		for (uint32_t idx{}; idx < nrTriangles; ++idx)
+			std::copy_n(indices.begin() + triangleOrder[idx] * 3, 3, reordered.begin() + idx * 3);
+		indices.swap(reordered);
+
+		// Soft boundaries: split a cluster as soon as its running ACMR is close enough to the cluster's own ACMR
+		constexpr float acmrThreshold{ 1.05f };
+		FifoCache cache{ nrVertices, cacheSize };
+		hardBoundaries.push_back(nrTriangles);
+		for (size_t clusterIdx{}; clusterIdx + 1 < hardBoundaries.size(); ++clusterIdx)
+		{
+			const uint32_t clusterBegin{ hardBoundaries[clusterIdx] };
+			const uint32_t clusterEnd{ hardBoundaries[clusterIdx + 1] };
+
+			cache.Flush();
+			const float clusterAcmr{ static_cast<float>(CountMisses(indices, clusterBegin, clusterEnd, cache)) / (clusterEnd - clusterBegin) };
+
+			cache.Flush();
+			uint32_t runningBegin{ clusterBegin };
+			uint32_t runningMisses{};
+			clusterOffsets.push_back(clusterBegin * 3);
+
+			for (uint32_t triIdx{ clusterBegin }; triIdx < clusterEnd; ++triIdx)
+			{
+				runningMisses += CountMisses(indices, triIdx, triIdx + 1, cache);
+
+				const uint32_t runningTriangles{ triIdx + 1 - runningBegin };
+				const bool isLast{ triIdx + 1 == clusterEnd };
+				if (!isLast && static_cast<float>(runningMisses) / runningTriangles <= clusterAcmr * acmrThreshold)
+				{
+					runningBegin = triIdx + 1;
+					runningMisses = 0;
+					cache.Flush();
+					clusterOffsets.push_back(runningBegin * 3);
+				}
+			}
+		}
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusterOffsets)
+	{
+		if (clusterOffsets.size() < 2)
+			return;
+
+		const size_t nrClusters{ clusterOffsets.size() };
+		const auto clusterEnd = [&](size_t clusterIdx)
+		{
+			return clusterIdx + 1 < nrClusters ? clusterOffsets[clusterIdx + 1] : static_cast<uint32_t>(indices.size());
+		};
+
+		// Area weighted centroids and normals, oriented along the vertex normals
+		Vector3 meshCentroid{};
+		float meshArea{};
+		std::vector<Vector3> clusterCentroids(nrClusters);
+		std::vector<Vector3> clusterNormals(nrClusters);
+		for (size_t clusterIdx{}; clusterIdx < nrClusters; ++clusterIdx)
+		{
+			float clusterArea{};
+			for (uint32_t idx{ clusterOffsets[clusterIdx] }; idx < clusterEnd(clusterIdx); idx += 3)
+			{
+				const Vertex& v0{ vertices[indices[idx]] };
+				const Vertex& v1{ vertices[indices[idx + 1]] };
+				const Vertex& v2{ vertices[indices[idx + 2]] };
+
+				const float area{ Vector3::Cross(v1.position - v0.position, v2.position - v0.position).Magnitude() * 0.5f };
+				const Vector3 centroid{ (v0.position + v1.position + v2.position) / 3.f };
+
+				clusterCentroids[clusterIdx] += centroid * area;
+				clusterNormals[clusterIdx] += (v0.normal + v1.normal + v2.normal) * area;
+				clusterArea += area;
+			}
+
+			meshCentroid += clusterCentroids[clusterIdx];
+			meshArea += clusterArea;
+			if (clusterArea > 0.f)
+				clusterCentroids[clusterIdx] /= clusterArea;
+		}
+		if (meshArea > 0.f)
+			meshCentroid /= meshArea;
+
+		std::vector<float> sortKeys(nrClusters);
+		for (size_t clusterIdx{}; clusterIdx < nrClusters; ++clusterIdx)
+		{
+			Vector3 normal{ clusterNormals[clusterIdx] };
+			if (normal.SqrMagnitude() > FLT_MIN)
+				normal.Normalize();
+			sortKeys[clusterIdx] = Vector3::Dot(clusterCentroids[clusterIdx] - meshCentroid, normal);
+		}
+
+		std::vector<uint32_t> clusterOrder(nrClusters);
+		std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b)
+		{
+			return sortKeys[a] > sortKeys[b];
+		});
+
+		std::vector<uint32_t> reordered{};
+		reordered.reserve(indices.size());
+		for (const uint32_t clusterIdx : clusterOrder)
+			reordered.insert(reordered.end(), indices.begin() + clusterOffsets[clusterIdx], indices.begin() + clusterEnd(clusterIdx));
+		indices.swap(reordered);
+	}
+
+	void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		constexpr uint32_t unassigned{ UINT32_MAX };
+		std::vector<uint32_t> remap(vertices.size(), unassigned);
+
+		std::vector<Vertex> reordered{};
+		reordered.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == unassigned)
+			{
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		// Unreferenced vertices are dropped
+		vertices.swap(reordered);
+	}
+
+	MeshOptimizer::OptimizationReport MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t cacheSize)
+	{
+		OptimizationReport report{};
+		report.before = AnalyzeVertexCache(indices, vertices.size(), cacheSize);
+
+		std::vector<uint32_t> clusterOffsets{};
+		OptimizeVertexCache(indices, vertices.size(), clusterOffsets, cacheSize);
+		OptimizeOverdraw(indices, vertices, clusterOffsets);
+		OptimizeVertexFetch(vertices, indices);
+
+		report.after = AnalyzeVertexCache(indices, vertices.size(), cacheSize);
+		return report;
+	}
+}
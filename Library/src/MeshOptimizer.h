@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	struct Vertex;
+
+	namespace MeshOptimizer
+	{
+		// Post-transform vertex cache efficiency of an indexed triangle list, measured with a FIFO cache
+		// ACMR: cache misses per triangle (0.5 is the ideal on big regular meshes, 3 means no reuse)
+		// ATVR: cache misses per vertex (1 is the ideal, every vertex transformed once)
+		struct VertexCacheStats
+		{
+			float acmr{};
+			float atvr{};
+		};
+
+		struct OptimizationReport
+		{
+			VertexCacheStats before{};
+			VertexCacheStats after{};
+		};
+
+		constexpr uint32_t DEFAULT_CACHE_SIZE{ 16 };
+
+		VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t nrVertices, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Tipsify (Sander et al. 2007) triangle reordering for the post-transform cache.
+		// Fills clusterOffsets with the first index of every cluster, clusters end at cache flushes (dead ends)
+		// or where the running ACMR already dropped close to the cluster's ACMR, so they can be reordered freely
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices, std::vector<uint32_t>& clusterOffsets, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Sorts the clusters so the ones facing away from the mesh center (likely occluders) are drawn first
+		void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusterOffsets);
+
+		// Renumbers the vertices in order of first use, so vertex fetches walk memory linearly
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// Runs all of the above in order
+		OptimizationReport Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+	}
+}
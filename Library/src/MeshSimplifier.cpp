@@ -0,0 +1,394 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "DataTypes.h"
+#include "MeshOptimizer.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint32_t INVALID_POSITION{ UINT32_MAX };
+		constexpr double PASS_COST_FACTOR{ 1.5 };
+
+		// Sum of squared distances to a set of planes as a symmetric 4x4 matrix, doubles keep long sums accurate
+		struct Quadric
+		{
+			double a2{}, ab{}, ac{}, ad{};
+			double b2{}, bc{}, bd{};
+			double c2{}, cd{};
+			double d2{};
+
+			// Plane through point with a unit normal
+			static Quadric FromPlane(const Vector3& normal, const Vector3& point)
+			{
+				const double a{ normal.x };
+				const double b{ normal.y };
+				const double c{ normal.z };
+				const double d{ -Vector3::Dot(normal, point) };
+				return { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+			}
+
+			Quadric& operator+=(const Quadric& other)
+			{
+				a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+				b2 += other.b2; bc += other.bc; bd += other.bd;
+				c2 += other.c2; cd += other.cd;
+				d2 += other.d2;
+				return *this;
+			}
+
+			double Evaluate(const Vector3& point) const
+			{
+				const double x{ point.x };
+				const double y{ point.y };
+				const double z{ point.z };
+				return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+					+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+					+ c2 * z * z + 2.0 * cd * z
+					+ d2;
+			}
+		};
+
+		struct Collapse
+		{
+			double cost{};
+			uint32_t from{};
+			uint32_t to{};
+		};
+
+		uint64_t GetEdgeKey(uint32_t from, uint32_t to)
+		{
+			return uint64_t{ from } << 32 | to;
+		}
+
+		// Vertices that only differ in their attributes (UV or normal seams) get the same position id
+		uint32_t WeldPositions(const std::vector<Vertex>& vertices, std::vector<uint32_t>& positionIds, std::vector<Vector3>& positions)
+		{
+			std::vector<uint32_t> order(vertices.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&vertices](uint32_t a, uint32_t b)
+			{
+				const Vector3& pa{ vertices[a].position };
+				const Vector3& pb{ vertices[b].position };
+				if (pa.x != pb.x)
+					return pa.x < pb.x;
+				if (pa.y != pb.y)
+					return pa.y < pb.y;
+				return pa.z < pb.z;
+			});
+
+			positionIds.resize(vertices.size());
+			positions.clear();
+			for (size_t idx{}; idx < order.size(); ++idx)
+			{
+				if (idx == 0 || !(vertices[order[idx]].position == vertices[order[idx - 1]].position))
+					positions.push_back(vertices[order[idx]].position);
+				positionIds[order[idx]] = static_cast<uint32_t>(positions.size() - 1);
+			}
+
+			return static_cast<uint32_t>(positions.size());
+		}
+
+		Vector3 GetUnnormalizedNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+		{
+			return Vector3::Cross(p1 - p0, p2 - p0);
+		}
+
+		float GetAttributeDistance(const Vertex& a, const Vertex& b)
+		{
+			return (a.uv - b.uv).SqrMagnitude() + (a.normal - b.normal).SqrMagnitude();
+		}
+	}
+
+	std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, std::span<const uint32_t> indices,
+		size_t targetIndexCount, float maxError, float& resultError)
+	{
+		std::vector<uint32_t> result(indices.begin(), indices.end());
+		resultError = 0.f;
+
+		std::vector<uint32_t> positionIds{};
+		std::vector<Vector3> positions{};
+		const uint32_t nrPositions{ WeldPositions(vertices, positionIds, positions) };
+
+		// Every vertex of a position, to pick the closest match when its position collapses into another one
+		std::vector<uint32_t> wedgeOffsets(nrPositions + 1, 0);
+		for (const uint32_t positionId : positionIds)
+			++wedgeOffsets[positionId + 1];
+		std::partial_sum(wedgeOffsets.begin(), wedgeOffsets.end(), wedgeOffsets.begin());
+		std::vector<uint32_t> wedgeVertices(vertices.size());
+		{
+			std::vector<uint32_t> fillOffsets{ wedgeOffsets.begin(), wedgeOffsets.end() - 1 };
+			for (uint32_t vertexIdx{}; vertexIdx < vertices.size(); ++vertexIdx)
+				wedgeVertices[fillOffsets[positionIds[vertexIdx]]++] = vertexIdx;
+		}
+
+		const auto getPosition = [&](uint32_t index) { return positionIds[index]; };
+
+		std::vector<uint64_t> directedEdges{};
+		const auto buildDirectedEdges = [&]()
+		{
+			directedEdges.clear();
+			for (size_t idx{}; idx < result.size(); idx += 3)
+			{
+				for (size_t corner{}; corner < 3; ++corner)
+					directedEdges.push_back(GetEdgeKey(getPosition(result[idx + corner]), getPosition(result[idx + (corner + 1) % 3])));
+			}
+			std::sort(directedEdges.begin(), directedEdges.end());
+		};
+		// An edge without a twin running the other way lies on an open border
+		const auto isBorderEdge = [&](uint32_t a, uint32_t b)
+		{
+			return !std::binary_search(directedEdges.begin(), directedEdges.end(), GetEdgeKey(b, a))
+				|| !std::binary_search(directedEdges.begin(), directedEdges.end(), GetEdgeKey(a, b));
+		};
+
+		// Face planes, plus planes standing on the border edges so borders keep their shape
+		std::vector<Quadric> quadrics(nrPositions);
+		buildDirectedEdges();
+		for (size_t idx{}; idx < result.size(); idx += 3)
+		{
+			const uint32_t triangle[3]{ getPosition(result[idx]), getPosition(result[idx + 1]), getPosition(result[idx + 2]) };
+			const Vector3 faceNormal{ GetUnnormalizedNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]) };
+			if (faceNormal.SqrMagnitude() <= 0.f)
+				continue;
+			const Vector3 unitNormal{ faceNormal.Normalized() };
+
+			const Quadric faceQuadric{ Quadric::FromPlane(unitNormal, positions[triangle[0]]) };
+			for (const uint32_t positionId : triangle)
+				quadrics[positionId] += faceQuadric;
+
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t a{ triangle[corner] };
+				const uint32_t b{ triangle[(corner + 1) % 3] };
+				if (!isBorderEdge(a, b))
+					continue;
+
+				const Vector3 borderNormal{ Vector3::Cross(positions[b] - positions[a], unitNormal) };
+				if (borderNormal.SqrMagnitude() <= 0.f)
+					continue;
+
+				const Quadric borderQuadric{ Quadric::FromPlane(borderNormal.Normalized(), positions[a]) };
+				quadrics[a] += borderQuadric;
+				quadrics[b] += borderQuadric;
+			}
+		}
+
+		const double costLimit{ static_cast<double>(maxError) * maxError };
+		double maxCost{};
+
+		std::vector<uint32_t> adjacencyOffsets{};
+		std::vector<uint32_t> adjacentTriangles{};
+		std::vector<bool> isBorder(nrPositions);
+		std::vector<bool> isLocked(nrPositions);
+		std::vector<uint32_t> collapseTargets(nrPositions, INVALID_POSITION);
+		std::vector<uint32_t> vertexRemap(vertices.size());
+		std::vector<uint64_t> edges{};
+		std::vector<Collapse> collapses{};
+		std::vector<uint32_t> collapsedPositions{};
+
+		while (result.size() > targetIndexCount)
+		{
+			const uint32_t nrTriangles{ static_cast<uint32_t>(result.size() / 3) };
+
+			// Position to triangle adjacency of the current triangles
+			adjacencyOffsets.assign(nrPositions + 1, 0);
+			for (const uint32_t index : result)
+				++adjacencyOffsets[getPosition(index) + 1];
+			std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+			adjacentTriangles.resize(result.size());
+			{
+				std::vector<uint32_t> fillOffsets{ adjacencyOffsets.begin(), adjacencyOffsets.end() - 1 };
+				for (uint32_t idx{}; idx < result.size(); ++idx)
+					adjacentTriangles[fillOffsets[getPosition(result[idx])]++] = idx / 3;
+			}
+
+			buildDirectedEdges();
+			std::fill(isBorder.begin(), isBorder.end(), false);
+			edges.clear();
+			for (const uint64_t directedEdge : directedEdges)
+			{
+				const uint32_t a{ static_cast<uint32_t>(directedEdge >> 32) };
+				const uint32_t b{ static_cast<uint32_t>(directedEdge) };
+				if (isBorderEdge(a, b))
+				{
+					isBorder[a] = true;
+					isBorder[b] = true;
+				}
+				edges.push_back(GetEdgeKey(std::min(a, b), std::max(a, b)));
+			}
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			// Border positions may only slide along the border, anything else would eat into the outline
+			const auto canCollapse = [&](uint32_t from, uint32_t to)
+			{
+				return !isBorder[from] || (isBorder[to] && isBorderEdge(from, to));
+			};
+
+			collapses.clear();
+			for (const uint64_t edge : edges)
+			{
+				const uint32_t a{ static_cast<uint32_t>(edge >> 32) };
+				const uint32_t b{ static_cast<uint32_t>(edge) };
+
+				Collapse best{ DBL_MAX, a, b };
+				if (canCollapse(a, b))
+					best = { quadrics[a].Evaluate(positions[b]), a, b };
+				if (canCollapse(b, a))
+				{
+					const double cost{ quadrics[b].Evaluate(positions[a]) };
+					if (cost < best.cost)
+						best = { cost, b, a };
+				}
+
+				if (best.cost <= costLimit)
+					collapses.push_back(best);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			// A collapse removes about 2 triangles
+			size_t collapseBudget{ std::max<size_t>((nrTriangles - targetIndexCount / 3) / 2, 1) };
+			// Locking skips many cheap collapses, without a bound one pass would run all the way up to costLimit
+			const double passCostLimit{ collapseBudget < collapses.size() ? collapses[collapseBudget].cost * PASS_COST_FACTOR : DBL_MAX };
+
+			std::fill(isLocked.begin(), isLocked.end(), false);
+			collapsedPositions.clear();
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.cost > passCostLimit)
+					break;
+				if (isLocked[collapse.from] || isLocked[collapse.to])
+					continue;
+
+				// Moving from onto to must not turn any of the remaining triangles around
+				bool isFlipping{ false };
+				for (uint32_t adjacencyIdx{ adjacencyOffsets[collapse.from] }; adjacencyIdx < adjacencyOffsets[collapse.from + 1] && !isFlipping; ++adjacencyIdx)
+				{
+					const uint32_t triIdx{ adjacentTriangles[adjacencyIdx] };
+					const uint32_t triangle[3]{ getPosition(result[triIdx * 3]), getPosition(result[triIdx * 3 + 1]), getPosition(result[triIdx * 3 + 2]) };
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+						continue;
+
+					Vector3 moved[3]{ positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+					const Vector3 normalBefore{ GetUnnormalizedNormal(moved[0], moved[1], moved[2]) };
+					for (uint32_t corner{}; corner < 3; ++corner)
+					{
+						if (triangle[corner] == collapse.from)
+							moved[corner] = positions[collapse.to];
+					}
+					isFlipping = Vector3::Dot(normalBefore, GetUnnormalizedNormal(moved[0], moved[1], moved[2])) <= 0.f;
+				}
+				if (isFlipping)
+					continue;
+
+				// Lock the whole neighbourhood, so every flip test above stays valid for the rest of the pass
+				for (uint32_t adjacencyIdx{ adjacencyOffsets[collapse.from] }; adjacencyIdx < adjacencyOffsets[collapse.from + 1]; ++adjacencyIdx)
+				{
+					const uint32_t triIdx{ adjacentTriangles[adjacencyIdx] };
+					for (uint32_t corner{}; corner < 3; ++corner)
+						isLocked[getPosition(result[triIdx * 3 + corner])] = true;
+				}
+				isLocked[collapse.to] = true;
+
+				collapseTargets[collapse.from] = collapse.to;
+				collapsedPositions.push_back(collapse.from);
+				maxCost = std::max(maxCost, collapse.cost);
+
+				if (--collapseBudget == 0)
+					break;
+			}
+
+			if (collapsedPositions.empty())
+				break;
+
+			// Every vertex of a collapsed position moves to the vertex of the target with the closest attributes
+			std::iota(vertexRemap.begin(), vertexRemap.end(), 0);
+			for (const uint32_t from : collapsedPositions)
+			{
+				const uint32_t to{ collapseTargets[from] };
+				quadrics[to] += quadrics[from];
+
+				for (uint32_t wedgeIdx{ wedgeOffsets[from] }; wedgeIdx < wedgeOffsets[from + 1]; ++wedgeIdx)
+				{
+					const uint32_t vertexIdx{ wedgeVertices[wedgeIdx] };
+
+					uint32_t bestVertex{ wedgeVertices[wedgeOffsets[to]] };
+					float bestDistance{ FLT_MAX };
+					for (uint32_t targetIdx{ wedgeOffsets[to] }; targetIdx < wedgeOffsets[to + 1]; ++targetIdx)
+					{
+						const float distance{ GetAttributeDistance(vertices[vertexIdx], vertices[wedgeVertices[targetIdx]]) };
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestVertex = wedgeVertices[targetIdx];
+						}
+					}
+					vertexRemap[vertexIdx] = bestVertex;
+				}
+
+				collapseTargets[from] = INVALID_POSITION;
+			}
+
+			// Drop the triangles that collapsed to a line
+			size_t writeIdx{};
+			for (size_t readIdx{}; readIdx < result.size(); readIdx += 3)
+			{
+				const uint32_t i0{ vertexRemap[result[readIdx]] };
+				const uint32_t i1{ vertexRemap[result[readIdx + 1]] };
+				const uint32_t i2{ vertexRemap[result[readIdx + 2]] };
+				const uint32_t p0{ getPosition(i0) };
+				const uint32_t p1{ getPosition(i1) };
+				const uint32_t p2{ getPosition(i2) };
+				if (p0 == p1 || p1 == p2 || p0 == p2)
+					continue;
+
+				result[writeIdx++] = i0;
+				result[writeIdx++] = i1;
+				result[writeIdx++] = i2;
+			}
+			result.resize(writeIdx);
+		}
+
+		resultError = static_cast<float>(std::sqrt(maxCost));
+		return result;
+	}
+
+	void MeshSimplifier::GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+	{
+		lods.clear();
+
+		const std::vector<uint32_t> lod0Indices{ indices };
+		lods.push_back({ 0, static_cast<uint32_t>(lod0Indices.size()), 0, 0, 0.f });
+
+		AABB bounds{};
+		for (const Vertex& vertex : vertices)
+			bounds.Grow(vertex.position);
+		if (!bounds.IsValid())
+			return;
+		const float maxError{ (bounds.max - bounds.min).Magnitude() * MAX_RELATIVE_ERROR };
+
+		// Every level starts from LOD 0 so errors don't stack up
+		for (uint32_t lodIdx{ 1 }; lodIdx < MAX_MESH_LODS; ++lodIdx)
+		{
+			const size_t targetIndexCount{ (lod0Indices.size() >> lodIdx) / 3 * 3 };
+
+			float error{};
+			std::vector<uint32_t> lodIndices{ Simplify(vertices, lod0Indices, targetIndexCount, maxError, error) };
+
+			// The error limit stopped it early, the next levels would not get any smaller either
+			if (lodIndices.size() > lods.back().indexCount * 3 / 4)
+				break;
+
+			std::vector<uint32_t> clusterOffsets{};
+			MeshOptimizer::OptimizeVertexCache(lodIndices, vertices.size(), clusterOffsets);
+
+			lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), 0, 0, std::max(error, lods.back().error) });
+			indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+		}
+	}
+}
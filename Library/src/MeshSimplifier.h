@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace dae
+{
+	struct Vertex;
+	struct MeshLod;
+
+	namespace MeshSimplifier
+	{
+		// Coarsest LOD allowed to move the surface by this fraction of the mesh's bounding box diagonal
+		constexpr float MAX_RELATIVE_ERROR{ 0.02f };
+
+		// Edge collapse simplification driven by quadric error metrics (Garland & Heckbert 1997).
+		// Vertices sharing a position are collapsed together, so UV and normal seams stay closed, and open borders are kept in place.
+		// Only removes vertices: the result indexes the same vertex array. Stops at targetIndexCount or when the next collapse
+		// would move the surface further than maxError. resultError is the largest error introduced, in object space
+		std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, std::span<const uint32_t> indices,
+			size_t targetIndexCount, float maxError, float& resultError);
+
+		// Takes indices as LOD 0 and appends up to MAX_MESH_LODS - 1 levels with about half the triangles of the level before.
+		// lods gets an entry for every level, including LOD 0. Levels that barely get smaller are left out
+		void GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+	}
+}
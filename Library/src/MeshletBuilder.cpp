@@ -0,0 +1,352 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint8_t UNUSED_LOCAL_INDEX{ 0xff };
+
+		// Cutoffs above 1 can never be reached, so the meshlet is never cone culled
+		constexpr float DISABLED_CONE_CUTOFF{ 2.f };
+
+		// How much a disconnected triangle facing away from the meshlet gets penalized
+		constexpr float CONE_WEIGHT{ 1.f };
+		constexpr float MIN_ALIGNMENT{ 0.85f };
+
+		// Uniform grid over triangle centroids, finds the closest triangle to continue a meshlet from
+		// when none of the remaining triangles share a vertex with it (seams split vertices a lot)
+		class TriangleGrid final
+		{
+		public:
+			explicit TriangleGrid(const std::vector<Vector3>& centroids)
+			{
+				for (const Vector3& centroid : centroids)
+					m_Bounds.Grow(centroid);
+
+				// Around 8 triangles per cell
+				const uint32_t nrTriangles{ static_cast<uint32_t>(centroids.size()) };
+				m_Resolution = std::max(1, static_cast<int>(std::cbrt(nrTriangles / 8.f)));
+
+				const Vector3 size{ m_Bounds.max - m_Bounds.min };
+				m_CellSize = std::max({ size.x, size.y, size.z, FLT_MIN }) / m_Resolution;
+
+				const size_t nrCells{ static_cast<size_t>(m_Resolution) * m_Resolution * m_Resolution };
+				m_CellOffsets.assign(nrCells + 1, 0);
+				for (const Vector3& centroid : centroids)
+					++m_CellOffsets[GetCellIndex(GetCell(centroid)) + 1];
+				for (size_t idx{}; idx < nrCells; ++idx)
+					m_CellOffsets[idx + 1] += m_CellOffsets[idx];
+
+				m_CellTriangles.resize(nrTriangles);
+				std::vector<uint32_t> fillOffsets{ m_CellOffsets.begin(), m_CellOffsets.end() - 1 };
+				for (uint32_t triIdx{}; triIdx < nrTriangles; ++triIdx)
+					m_CellTriangles[fillOffsets[GetCellIndex(GetCell(centroids[triIdx]))]++] = triIdx;
+			}
+
+			// Visits the cells in rings around position until no unvisited cell can hold anything cheaper than the best so far.
+			// cost(triIdx) returns FLT_MAX to skip a triangle and never returns less than the distance to the centroid
+			template<typename CostFunction>
+			uint32_t FindCheapest(const Vector3& position, uint32_t invalidTriangle, CostFunction cost) const
+			{
+				const std::array<int, 3> home{ GetCell(position) };
+
+				uint32_t bestTriangle{ invalidTriangle };
+				float bestCost{ FLT_MAX };
+				for (int ring{}; ring < m_Resolution; ++ring)
+				{
+					// Everything from this ring outwards is at least this far away
+					if (bestCost < (ring - 1) * m_CellSize)
+						break;
+
+					for (int z{ home[2] - ring }; z <= home[2] + ring; ++z)
+					{
+						for (int y{ home[1] - ring }; y <= home[1] + ring; ++y)
+						{
+							for (int x{ home[0] - ring }; x <= home[0] + ring; ++x)
+							{
+								const bool isOnRing{ std::max({ std::abs(x - home[0]), std::abs(y - home[1]), std::abs(z - home[2]) }) == ring };
+								if (!isOnRing || !IsInGrid(x) || !IsInGrid(y) || !IsInGrid(z))
+									continue;
+
+								const size_t cellIdx{ GetCellIndex({ x, y, z }) };
+								for (uint32_t idx{ m_CellOffsets[cellIdx] }; idx < m_CellOffsets[cellIdx + 1]; ++idx)
+								{
+									const float triangleCost{ cost(m_CellTriangles[idx]) };
+									if (triangleCost < bestCost)
+									{
+										bestCost = triangleCost;
+										bestTriangle = m_CellTriangles[idx];
+									}
+								}
+							}
+						}
+					}
+				}
+
+				return bestTriangle;
+			}
+
+		private:
+			std::array<int, 3> GetCell(const Vector3& position) const
+			{
+				const Vector3 local{ (position - m_Bounds.min) / m_CellSize };
+				return {
+					std::clamp(static_cast<int>(local.x), 0, m_Resolution - 1),
+					std::clamp(static_cast<int>(local.y), 0, m_Resolution - 1),
+					std::clamp(static_cast<int>(local.z), 0, m_Resolution - 1)
+				};
+			}
+
+			size_t GetCellIndex(const std::array<int, 3>& cell) const
+			{
+				return (static_cast<size_t>(cell[2]) * m_Resolution + cell[1]) * m_Resolution + cell[0];
+			}
+
+			bool IsInGrid(int coordinate) const
+			{
+				return coordinate >= 0 && coordinate < m_Resolution;
+			}
+
+			AABB m_Bounds{};
+			float m_CellSize{};
+			int m_Resolution{};
+			std::vector<uint32_t> m_CellOffsets{};
+			std::vector<uint32_t> m_CellTriangles{};
+		};
+
+		Vector3 GetTriangleNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+		{
+			const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+			const float length{ normal.Magnitude() };
+			return length > 0.f ? normal / length : Vector3{};
+		}
+	}
+
+	void MeshletBuilder::Build(const std::vector<Vertex>& vertices, std::span<const uint32_t> indices,
+		std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles)
+	{
+		const size_t firstMeshlet{ meshlets.size() };
+
+		const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+		const size_t nrVertices{ vertices.size() };
+		if (nrTriangles == 0)
+			return;
+
+		std::vector<Vector3> triangleNormals(nrTriangles);
+		std::vector<Vector3> triangleCentroids(nrTriangles);
+		for (uint32_t triIdx{}; triIdx < nrTriangles; ++triIdx)
+		{
+			const Vector3& p0{ vertices[indices[triIdx * 3]].position };
+			const Vector3& p1{ vertices[indices[triIdx * 3 + 1]].position };
+			const Vector3& p2{ vertices[indices[triIdx * 3 + 2]].position };
+			triangleNormals[triIdx] = GetTriangleNormal(p0, p1, p2);
+			triangleCentroids[triIdx] = (p0 + p1 + p2) / 3.f;
+		}
+		const TriangleGrid grid{ triangleCentroids };
+
+		// Vertex to triangle adjacency, compressed into one array
+		std::vector<uint32_t> adjacencyOffsets(nrVertices + 1, 0);
+		for (const uint32_t index : indices)
+			++adjacencyOffsets[index + 1];
+		for (size_t idx{}; idx < nrVertices; ++idx)
+			adjacencyOffsets[idx + 1] += adjacencyOffsets[idx];
+
+		std::vector<uint32_t> adjacentTriangles(indices.size());
+		std::vector<uint32_t> fillOffsets{ adjacencyOffsets.begin(), adjacencyOffsets.end() - 1 };
+		for (uint32_t idx{}; idx < indices.size(); ++idx)
+			adjacentTriangles[fillOffsets[indices[idx]]++] = idx / 3;
+
+		std::vector<bool> isEmitted(nrTriangles, false);
+		std::vector<uint8_t> localIndices(nrVertices, UNUSED_LOCAL_INDEX);
+
+		Meshlet meshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+		Vector3 normalSum{};
+		Vector3 centroidSum{};
+		uint32_t nextSeed{};
+
+		const auto countNewVertices = [&](uint32_t triIdx)
+		{
+			uint32_t count{};
+			for (uint32_t corner{}; corner < 3; ++corner)
+				count += localIndices[indices[triIdx * 3 + corner]] == UNUSED_LOCAL_INDEX;
+			return count;
+		};
+
+		const auto flush = [&]()
+		{
+			if (meshlet.triangleCount == 0)
+				return;
+
+			for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+				localIndices[meshletVertices[meshlet.vertexOffset + idx]] = UNUSED_LOCAL_INDEX;
+
+			meshlets.push_back(meshlet);
+			meshlet = {};
+			meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+			normalSum = {};
+			centroidSum = {};
+		};
+
+		for (uint32_t nrEmitted{}; nrEmitted < nrTriangles; ++nrEmitted)
+		{
+			uint32_t bestTriangle{ nrTriangles };
+			uint32_t bestNewVertices{ 4 };
+			float bestAlignment{ -FLT_MAX };
+
+			const Vector3 axis{ normalSum.Normalized() };
+
+			// Only triangles touching the meshlet are candidates, anything else would start a disconnected island
+			for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+			{
+				const uint32_t vertexIdx{ meshletVertices[meshlet.vertexOffset + idx] };
+				for (uint32_t adjacencyIdx{ adjacencyOffsets[vertexIdx] }; adjacencyIdx < adjacencyOffsets[vertexIdx + 1]; ++adjacencyIdx)
+				{
+					const uint32_t triIdx{ adjacentTriangles[adjacencyIdx] };
+					if (isEmitted[triIdx])
+						continue;
+
+					const uint32_t newVertices{ countNewVertices(triIdx) };
+					if (meshlet.vertexCount + newVertices > MAX_VERTICES)
+						continue;
+
+					// Rather start a new meshlet than end up with a cone that can never be culled
+					const float alignment{ Vector3::Dot(triangleNormals[triIdx], axis) };
+					if (alignment < MIN_ALIGNMENT)
+						continue;
+
+					if (newVertices < bestNewVertices || (newVertices == bestNewVertices && alignment > bestAlignment))
+					{
+						bestTriangle = triIdx;
+						bestNewVertices = newVertices;
+						bestAlignment = alignment;
+					}
+				}
+			}
+
+			// Nothing connected fits, continue with the closest triangle that still faces roughly the same way
+			if (bestTriangle == nrTriangles && meshlet.triangleCount > 0)
+			{
+				const Vector3 center{ centroidSum / static_cast<float>(meshlet.triangleCount) };
+				bestTriangle = grid.FindCheapest(center, nrTriangles, [&](uint32_t triIdx)
+				{
+					if (isEmitted[triIdx] || meshlet.vertexCount + countNewVertices(triIdx) > MAX_VERTICES)
+						return FLT_MAX;
+
+					const float alignment{ Vector3::Dot(triangleNormals[triIdx], axis) };
+					if (alignment < MIN_ALIGNMENT)
+						return FLT_MAX;
+
+					// Facing away from the cone counts up to 3 times the distance
+					const float distance{ (triangleCentroids[triIdx] - center).Magnitude() };
+					return distance * (1.f + CONE_WEIGHT * (1.f - alignment));
+				});
+			}
+
+			// Dead end, start over from the first triangle that is left
+			if (bestTriangle == nrTriangles)
+			{
+				flush();
+				while (isEmitted[nextSeed])
+					++nextSeed;
+				bestTriangle = nextSeed;
+			}
+
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertexIdx{ indices[bestTriangle * 3 + corner] };
+				if (localIndices[vertexIdx] == UNUSED_LOCAL_INDEX)
+				{
+					localIndices[vertexIdx] = static_cast<uint8_t>(meshlet.vertexCount++);
+					meshletVertices.push_back(vertexIdx);
+				}
+				meshletTriangles.push_back(localIndices[vertexIdx]);
+			}
+
+			++meshlet.triangleCount;
+			isEmitted[bestTriangle] = true;
+			normalSum += triangleNormals[bestTriangle];
+			centroidSum += triangleCentroids[bestTriangle];
+
+			if (meshlet.triangleCount == MAX_TRIANGLES)
+				flush();
+		}
+		flush();
+
+		for (size_t idx{ firstMeshlet }; idx < meshlets.size(); ++idx)
+			ComputeBounds(meshlets[idx], vertices, meshletVertices, meshletTriangles);
+	}
+
+	void MeshletBuilder::ComputeBounds(Meshlet& meshlet, std::span<const Vertex> vertices, std::span<const uint32_t> meshletVertices, std::span<const uint8_t> meshletTriangles)
+	{
+		const auto getPosition = [&](uint32_t localIdx) -> const Vector3&
+		{
+			return vertices[meshletVertices[meshlet.vertexOffset + localIdx]].position;
+		};
+
+		AABB box{};
+		for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+			box.Grow(getPosition(idx));
+
+		meshlet.center = box.GetCenter();
+		meshlet.radius = 0.f;
+		for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+			meshlet.radius = std::max(meshlet.radius, (getPosition(idx) - meshlet.center).Magnitude());
+
+		// The cone axis is the average face normal, the cutoff comes from the normal furthest away from it
+		Vector3 normalSum{};
+		for (uint32_t triIdx{}; triIdx < meshlet.triangleCount; ++triIdx)
+		{
+			const uint8_t* pTriangle{ &meshletTriangles[meshlet.triangleOffset + triIdx * 3] };
+			normalSum += GetTriangleNormal(getPosition(pTriangle[0]), getPosition(pTriangle[1]), getPosition(pTriangle[2]));
+		}
+
+		meshlet.coneAxis = Vector3::UnitZ;
+		meshlet.coneApex = meshlet.center;
+		meshlet.coneCutoff = DISABLED_CONE_CUTOFF;
+
+		const float normalSumLength{ normalSum.Magnitude() };
+		if (normalSumLength <= 0.f)
+			return;
+		const Vector3 axis{ normalSum / normalSumLength };
+
+		float minAlignment{ 1.f };
+		for (uint32_t triIdx{}; triIdx < meshlet.triangleCount; ++triIdx)
+		{
+			const uint8_t* pTriangle{ &meshletTriangles[meshlet.triangleOffset + triIdx * 3] };
+			const Vector3 normal{ GetTriangleNormal(getPosition(pTriangle[0]), getPosition(pTriangle[1]), getPosition(pTriangle[2])) };
+
+			// Degenerate triangles are never rasterized, they don't widen the cone
+			if (normal.SqrMagnitude() > 0.f)
+				minAlignment = std::min(minAlignment, Vector3::Dot(normal, axis));
+		}
+
+		// A cone wider than a half space can face the camera from anywhere
+		if (minAlignment <= 0.f)
+			return;
+
+		// Move the apex back along the axis until it is behind every triangle plane
+		float maxOffset{};
+		for (uint32_t triIdx{}; triIdx < meshlet.triangleCount; ++triIdx)
+		{
+			const uint8_t* pTriangle{ &meshletTriangles[meshlet.triangleOffset + triIdx * 3] };
+			const Vector3& p0{ getPosition(pTriangle[0]) };
+			const Vector3 normal{ GetTriangleNormal(p0, getPosition(pTriangle[1]), getPosition(pTriangle[2])) };
+
+			const float normalAlignment{ Vector3::Dot(axis, normal) };
+			if (normalAlignment <= 0.f)
+				continue;
+			maxOffset = std::max(maxOffset, Vector3::Dot(meshlet.center - p0, normal) / normalAlignment);
+		}
+
+		meshlet.coneAxis = axis;
+		meshlet.coneApex = meshlet.center - axis * maxOffset;
+		meshlet.coneCutoff = std::sqrt(1.f - minAlignment * minAlignment);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace MeshletBuilder
+	{
+		// 64 vertices fit one decode batch, 124 triangles keep the local index stream a multiple of 4 bytes
+		constexpr uint32_t MAX_VERTICES{ 64 };
+		constexpr uint32_t MAX_TRIANGLES{ 124 };
+
+		// Splits an indexed triangle list into meshlets and appends them, in index order.
+		// A meshlet grows over the connected triangles that add the fewest new vertices, ties go to the one that keeps the normal cone tightest.
+		// When nothing connected fits it continues with the closest triangle instead, and triangles that would widen the cone too much are never added.
+		// Run it after MeshOptimizer so the seeds follow the cache optimized order
+		void Build(const std::vector<Vertex>& vertices, std::span<const uint32_t> indices,
+			std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles);
+
+		// Fills the bounding sphere and normal cone of a meshlet whose vertices and triangles are already assigned
+		void ComputeBounds(Meshlet& meshlet, std::span<const Vertex> vertices, std::span<const uint32_t> meshletVertices, std::span<const uint8_t> meshletTriangles);
+
+		// True when every triangle of the meshlet is back-facing as seen from cameraPosition.
+		// The cone has to be in the same space as the camera
+		inline bool IsBackFacing(const Vector3& coneApex, const Vector3& coneAxis, float coneCutoff, const Vector3& cameraPosition)
+		{
+			return Vector3::Dot((coneApex - cameraPosition).Normalized(), coneAxis) >= coneCutoff;
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#include "TangentSpace.h"
+
+#include "DataTypes.h"
+#include "JobSystem.h"
+
+namespace dae
+{
+	namespace
+	{
+		float AngleBetween(const Vector3& v1, const Vector3& v2)
+		{
+			const float lengths{ v1.Magnitude() * v2.Magnitude() };
+			if (lengths <= FLT_MIN)
+				return 0.f;
+			return acosf(Clamp(Vector3::Dot(v1, v2) / lengths, -1.f, 1.f));
+		}
+
+		Vector3 ProjectOnPlane(const Vector3& v, const Vector3& normal)
+		{
+			if (normal.SqrMagnitude() <= FLT_MIN)
+				return v;
+			return Vector3::Reject(v, normal);
+		}
+
+		// Any unit vector perpendicular to the normal, for vertices without usable uvs
+		Vector3 FallbackTangent(const Vector3& normal)
+		{
+			const Vector3 axis{ abs(normal.x) < 0.9f ? Vector3::UnitX : Vector3::UnitY };
+			Vector3 tangent{ ProjectOnPlane(axis, normal) };
+			tangent.Normalize();
+			return tangent;
+		}
+
+		struct TriangleTangent
+		{
+			Vector3 tangent{};
+			float cornerAngles[3]{};
+		};
+	}
+
+	void TangentSpace::GenerateTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		constexpr uint32_t chunkSize{ 1024 };
+
+		const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+		const uint32_t nrVertices{ static_cast<uint32_t>(vertices.size()) };
+
+		// Pass 1: one unit tangent + corner angles per triangle, every triangle only writes its own slot
+		std::vector<TriangleTangent> triangleTangents(nrTriangles);
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+		jobSystem.ParallelFor(nrTriangles, chunkSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t triIdx{ begin }; triIdx < end; ++triIdx)
+			{
+				const Vertex& v0{ vertices[indices[triIdx * 3]] };
+				const Vertex& v1{ vertices[indices[triIdx * 3 + 1]] };
+				const Vertex& v2{ vertices[indices[triIdx * 3 + 2]] };
+
+				const Vector3 edge0{ v1.position - v0.position };
+				const Vector3 edge1{ v2.position - v0.position };
+				const Vector2 diffX{ v1.uv.x - v0.uv.x, v2.uv.x - v0.uv.x };
+				const Vector2 diffY{ v1.uv.y - v0.uv.y, v2.uv.y - v0.uv.y };
+
+				TriangleTangent& result{ triangleTangents[triIdx] };
+				result.cornerAngles[0] = AngleBetween(edge0, edge1);
+				result.cornerAngles[1] = AngleBetween(v2.position - v1.position, -edge0);
+				result.cornerAngles[2] = PI - result.cornerAngles[0] - result.cornerAngles[1];
+
+				// Only the sign of the uv area matters once the tangent is normalized
+				const float uvArea{ Vector2::Cross(diffX, diffY) };
+				if (abs(uvArea) <= FLT_MIN)
+					continue;
+
+				result.tangent = (edge0 * diffY.y - edge1 * diffY.x) * (uvArea > 0.f ? 1.f : -1.f);
+				if (result.tangent.SqrMagnitude() > FLT_MIN)
+					result.tangent.Normalize();
+			}
+		});
+
+		// Vertex to triangle adjacency (CSR): cornerOffsets[v]..cornerOffsets[v + 1] indexes into corners
+		// Each corner stores triangleIdx * 3 + cornerIdx
+		std::vector<uint32_t> cornerOffsets(nrVertices + 1, 0);
+		for (const uint32_t index : indices)
+			++cornerOffsets[index + 1];
+		for (uint32_t idx{}; idx < nrVertices; ++idx)
+			cornerOffsets[idx + 1] += cornerOffsets[idx];
+
+		std::vector<uint32_t> corners(indices.size());
+		std::vector<uint32_t> fillOffsets{ cornerOffsets.begin(), cornerOffsets.end() - 1 };
+		for (uint32_t cornerIdx{}; cornerIdx < nrTriangles * 3; ++cornerIdx)
+			corners[fillOffsets[indices[cornerIdx]]++] = cornerIdx;
+
+		// Pass 2: every vertex gathers its own triangles, so no two threads write the same vertex
+		jobSystem.ParallelFor(nrVertices, chunkSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t vertexIdx{ begin }; vertexIdx < end; ++vertexIdx)
+			{
+				Vertex& vertex{ vertices[vertexIdx] };
+
+				Vector3 tangent{};
+				for (uint32_t idx{ cornerOffsets[vertexIdx] }; idx < cornerOffsets[vertexIdx + 1]; ++idx)
+				{
+					const TriangleTangent& triangle{ triangleTangents[corners[idx] / 3] };
+					Vector3 projected{ ProjectOnPlane(triangle.tangent, vertex.normal) };
+					if (projected.SqrMagnitude() <= FLT_MIN)
+						continue;
+
+					projected.Normalize();
+					tangent += projected * triangle.cornerAngles[corners[idx] % 3];
+				}
+
+				if (tangent.SqrMagnitude() > FLT_MIN)
+					vertex.tangent = tangent.Normalized();
+				else
+					vertex.tangent = FallbackTangent(vertex.normal);
+			}
+		});
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	struct Vertex;
+
+	namespace TangentSpace
+	{
+		// Fills Vertex::tangent for an indexed triangle list, following MikkTSpace:
+		// per-triangle tangents are normalized, projected onto each vertex normal plane and averaged with angle weights.
+		// Runs in two parallel passes (triangles, then a gather per vertex over a vertex-to-triangle adjacency list),
+		// so no two threads ever write the same vertex.
+		void GenerateTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	}
+}
@@ -6,7 +6,9 @@ namespace dae
 {
 	Texture::Texture(SDL_Surface* pSurface) :
 		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+		m_pSurfacePixels{ (uint32_t*)pSurface->pixels },
+		m_Width{ pSurface->w },
+		m_Height{ pSurface->h }
 	{
 	}
 
@@ -21,18 +23,53 @@ namespace dae
 
 	Texture* Texture::LoadFromFile(const std::string& path)
 	{
-		//TODO
-		//Load SDL_Surface using IMG_LOAD
-		//Create & Return a new Texture Object (using SDL_Surface)
+		SDL_Surface* pLoadedSurface{ IMG_Load(path.c_str()) };
+		if (!pLoadedSurface)
+			return nullptr;
 
-		return nullptr;
+		// Images can come in any format, Sample expects 32 bits per pixel
+		SDL_Surface* pSurface{ SDL_ConvertSurfaceFormat(pLoadedSurface, SDL_PIXELFORMAT_ARGB8888, 0) };
+		SDL_FreeSurface(pLoadedSurface);
+		if (!pSurface)
+			return nullptr;
+
+		return new Texture{ pSurface };
 	}
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
-		//TODO
-		//Sample the correct texel for the given uv
+		// Clamp to the edges, point sampling
+		const int x{ std::clamp(static_cast<int>(uv.x * m_Width), 0, m_Width - 1) };
+		const int y{ std::clamp(static_cast<int>(uv.y * m_Height), 0, m_Height - 1) };
+
+		Uint8 r{}, g{}, b{};
+		SDL_GetRGB(m_pSurfacePixels[x + y * m_Width], m_pSurface->format, &r, &g, &b);
+
+		constexpr float toUnit{ 1.f / 255.f };
+		return { r * toUnit, g * toUnit, b * toUnit };
+	}
+
+	void Texture::Sample(__m128 u, __m128 v, __m128& r, __m128& g, __m128& b) const
+	{
+		// Clamping before the truncation gives the same texels as clamping the truncated ints, NaN ends up at 0 too
+		const __m128 maxX{ _mm_set1_ps(static_cast<float>(m_Width - 1)) };
+		const __m128 maxY{ _mm_set1_ps(static_cast<float>(m_Height - 1)) };
+		const __m128 zero{ _mm_setzero_ps() };
+		alignas(16) int32_t x[4];
+		alignas(16) int32_t y[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(x), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(m_Width))), zero), maxX)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(y), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(m_Height))), zero), maxY)));
 
-		return {};
+		// SSE2 has no gather, LoadFromFile made every texel ARGB8888 so the channels unpack without SDL_GetRGB
+		const __m128i texels{ _mm_setr_epi32(
+			static_cast<int>(m_pSurfacePixels[x[0] + y[0] * m_Width]),
+			static_cast<int>(m_pSurfacePixels[x[1] + y[1] * m_Width]),
+			static_cast<int>(m_pSurfacePixels[x[2] + y[2] * m_Width]),
+			static_cast<int>(m_pSurfacePixels[x[3] + y[3] * m_Width])) };
+		const __m128i channelMask{ _mm_set1_epi32(0xFF) };
+		const __m128 toUnit{ _mm_set1_ps(1.f / 255.f) };
+		r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), channelMask)), toUnit);
+		g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8), channelMask)), toUnit);
+		b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, channelMask)), toUnit);
 	}
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <SDL_surface.h>
+#include <emmintrin.h>
 #include <string>
 #include "ColorRGB.h"
 
@@ -14,11 +15,18 @@ namespace dae
 
 		static Texture* LoadFromFile(const std::string& path);
 		ColorRGB Sample(const Vector2& uv) const;
+		// Same as Sample for 4 uvs at once, the channels come out in SSE lanes
+		void Sample(__m128 u, __m128 v, __m128& r, __m128& g, __m128& b) const;
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
 
 	private:
 		Texture(SDL_Surface* pSurface);
 
 		SDL_Surface* m_pSurface{ nullptr };
 		uint32_t* m_pSurfacePixels{ nullptr };
+		int m_Width{};
+		int m_Height{};
 	};
 }
\ No newline at end of file
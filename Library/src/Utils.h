@@ -2,10 +2,10 @@
 #include <array>
 #include <cassert>
 #include <fstream>
+#include <unordered_map>
 #include "Maths.h"
 #include "DataTypes.h"
-
-#define DISABLE_OBJ
+#include "TangentSpace.h"
 
 namespace dae
 {
@@ -38,19 +38,37 @@ namespace dae
 
 	namespace Utils
 	{
+		// Identifies a unique face corner by its OBJ (position, uv, normal) indices
+		struct ObjVertexKey
+		{
+			size_t position{};
+			size_t texCoord{};
+			size_t normal{};
+
+			bool operator==(const ObjVertexKey& other) const
+			{
+				return position == other.position && texCoord == other.texCoord && normal == other.normal;
+			}
+		};
+
+		struct ObjVertexKeyHash
+		{
+			size_t operator()(const ObjVertexKey& key) const
+			{
+				// Combine like boost::hash_combine
+				size_t hash{ std::hash<size_t>{}(key.position) };
+				hash ^= std::hash<size_t>{}(key.texCoord) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+				hash ^= std::hash<size_t>{}(key.normal) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+				return hash;
+			}
+		};
+
 		//Just parses vertices and indices
+		//Face corners sharing the same (position, uv, normal) reuse one vertex
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true)
 		{
-#ifdef DISABLE_OBJ
-
-			//TODO: Enable the code below after uncommenting all the vertex attributes of DataTypes::Vertex
-			// >> Comment/Remove '#define DISABLE_OBJ'
-			assert(false && "OBJ PARSER not enabled! Check the comments in Utils::ParseOBJ");
-
-#else
-
 			std::ifstream file(filename);
 			if (!file)
 				return false;
@@ -62,6 +80,9 @@ namespace dae
 			vertices.clear();
 			indices.clear();
 
+			// Maps every (position, uv, normal) combination to its index in vertices
+			std::unordered_map<ObjVertexKey, uint32_t, ObjVertexKeyHash> vertexLookup{};
+
 			std::string sCommand;
 			// start a while iteration ending when the end of file is reached (ios::eof)
 			while (!file.eof())
@@ -104,15 +125,12 @@ namespace dae
 					//add the material index as attibute to the attribute array
 					//
 					// Faces or triangles
-					Vertex vertex{};
-					size_t iPosition, iTexCoord, iNormal;
-
 					uint32_t tempIndices[3];
 					for (size_t iFace = 0; iFace < 3; iFace++)
 					{
-						// OBJ format uses 1-based arrays
-						file >> iPosition;
-						vertex.position = positions[iPosition - 1];
+						// OBJ format uses 1-based arrays, 0 means the attribute is missing
+						ObjVertexKey key{};
+						file >> key.position;
 
 						if ('/' == file.peek())//is next in buffer ==  '/' ?
 						{
@@ -121,8 +139,7 @@ namespace dae
 							if ('/' != file.peek())
 							{
 								// Optional texture coordinate
-								file >> iTexCoord;
-								vertex.uv = UVs[iTexCoord - 1];
+								file >> key.texCoord;
 							}
 
 							if ('/' == file.peek())
@@ -130,14 +147,25 @@ namespace dae
 								file.ignore();
 
 								// Optional vertex normal
-								file >> iNormal;
-								vertex.normal = normals[iNormal - 1];
+								file >> key.normal;
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						//indices.push_back(uint32_t(vertices.size()) - 1);
+						// Reuse the vertex if this corner was already seen
+						const auto [it, isNew] { vertexLookup.try_emplace(key, uint32_t(vertices.size())) };
+						if (isNew)
+						{
+							Vertex vertex{};
+							vertex.position = positions[key.position - 1];
+							if (key.texCoord)
+								vertex.uv = UVs[key.texCoord - 1];
+							if (key.normal)
+								vertex.normal = normals[key.normal - 1];
+
+							vertices.push_back(vertex);
+						}
+
+						tempIndices[iFace] = it->second;
 					}
 
 					indices.push_back(tempIndices[0]);
@@ -156,48 +184,19 @@ namespace dae
 				file.ignore(1000, '\n');
 			}
 
-			//Cheap Tangent Calculations
-			for (uint32_t i = 0; i < indices.size(); i += 3)
-			{
-				uint32_t index0 = indices[i];
-				uint32_t index1 = indices[size_t(i) + 1];
-				uint32_t index2 = indices[size_t(i) + 2];
-
-				const Vector3& p0 = vertices[index0].position;
-				const Vector3& p1 = vertices[index1].position;
-				const Vector3& p2 = vertices[index2].position;
-				const Vector2& uv0 = vertices[index0].uv;
-				const Vector2& uv1 = vertices[index1].uv;
-				const Vector2& uv2 = vertices[index2].uv;
-
-				const Vector3 edge0 = p1 - p0;
-				const Vector3 edge1 = p2 - p0;
-				const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
-				const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
-				float r = 1.f / Vector2::Cross(diffX, diffY);
-
-				Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
-				vertices[index0].tangent += tangent;
-				vertices[index1].tangent += tangent;
-				vertices[index2].tangent += tangent;
-			}
+			TangentSpace::GenerateTangents(vertices, indices);
 
-			//Fix the tangents per vertex now because we accumulated
-			for (auto& v : vertices)
+			if (flipAxisAndWinding)
 			{
-				v.tangent = Vector3::Reject(v.tangent, v.normal).Normalized();
-
-				if(flipAxisAndWinding)
+				for (auto& v : vertices)
 				{
 					v.position.z *= -1.f;
 					v.normal.z *= -1.f;
 					v.tangent.z *= -1.f;
 				}
-
 			}
 
 			return true;
-#endif
 		}
 #pragma warning(pop)
 	}
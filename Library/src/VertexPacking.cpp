@@ -0,0 +1,220 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace
+	{
+		int16_t ToSnorm16(float value)
+		{
+			return static_cast<int16_t>(std::lround(Clamp(value, -1.f, 1.f) * 32767.f));
+		}
+
+		uint8_t ToUnorm8(float value)
+		{
+			return static_cast<uint8_t>(std::lround(Saturate(value) * 255.f));
+		}
+
+		// 4 half floats in the low 16 bits of each lane -> 4 floats (Fabian Giesen's SSE2 conversion)
+		__m128 HalfToFloat4(__m128i halves)
+		{
+			const __m128i noSignMask{ _mm_set1_epi32(0x7fff) };
+			const __m128 magic{ _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)) };
+			const __m128i wasInfNan{ _mm_set1_epi32(0x7bff) };
+			const __m128i expInfNan{ _mm_set1_epi32(255 << 23) };
+
+			const __m128i noSign{ _mm_and_si128(halves, noSignMask) };
+			const __m128i sign{ _mm_slli_epi32(_mm_xor_si128(halves, noSign), 16) };
+			const __m128 scaled{ _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(noSign, 13)), magic) };
+			const __m128i infNan{ _mm_and_si128(_mm_cmpgt_epi32(noSign, wasInfNan), expInfNan) };
+
+			return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+		}
+
+		// Two octahedral vectors as (x0, y0, x1, y1) snorm -> unit vectors
+		void DecodeOctahedral2(uint32_t encoded0, uint32_t encoded1, Vector3& out0, Vector3& out1)
+		{
+			const __m128i packed{ _mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(encoded0)), _mm_cvtsi32_si128(static_cast<int>(encoded1))) };
+			// Sign extend the 16 bit halves
+			const __m128i extended{ _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16) };
+			const __m128 xy{ _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(extended), _mm_set1_ps(1.f / 32767.f)), _mm_set1_ps(-1.f)) };
+
+			const __m128 signMask{ _mm_set1_ps(-0.f) };
+			const __m128 absXY{ _mm_andnot_ps(signMask, xy) };
+			const __m128 absYX{ _mm_shuffle_ps(absXY, absXY, _MM_SHUFFLE(2, 3, 0, 1)) };
+			// z = 1 - |x| - |y|, duplicated in both lanes of a pair
+			const __m128 z{ _mm_sub_ps(_mm_set1_ps(1.f), _mm_add_ps(absXY, absYX)) };
+
+			// Fold the lower hemisphere back: xy -= copysign(max(-z, 0), xy)
+			const __m128 fold{ _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps()) };
+			const __m128 unfolded{ _mm_sub_ps(xy, _mm_or_ps(fold, _mm_and_ps(xy, signMask))) };
+
+			const __m128 squared{ _mm_mul_ps(unfolded, unfolded) };
+			const __m128 lengthSq{ _mm_add_ps(_mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 3, 0, 1))), _mm_mul_ps(z, z)) };
+			const __m128 invLength{ _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(lengthSq)) };
+
+			alignas(16) float resultXY[4];
+			alignas(16) float resultZ[4];
+			_mm_store_ps(resultXY, _mm_mul_ps(unfolded, invLength));
+			_mm_store_ps(resultZ, _mm_mul_ps(z, invLength));
+
+			out0 = { resultXY[0], resultXY[1], resultZ[0] };
+			out1 = { resultXY[2], resultXY[3], resultZ[2] };
+		}
+	}
+
+	uint16_t VertexPacking::FloatToHalf(float value)
+	{
+		uint32_t bits{};
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign{ (bits >> 16) & 0x8000 };
+		const uint32_t exponent{ (bits >> 23) & 0xff };
+		uint32_t mantissa{ bits & 0x7fffff };
+
+		// NaN stays NaN, Inf stays Inf
+		if (exponent == 0xff)
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+		const int halfExponent{ static_cast<int>(exponent) - 127 + 15 };
+		if (halfExponent >= 0x1f)
+			return static_cast<uint16_t>(sign | 0x7c00);
+
+		if (halfExponent <= 0)
+		{
+			// Denormal or zero
+			if (halfExponent < -10)
+				return static_cast<uint16_t>(sign);
+
+			mantissa |= 0x800000;
+			const uint32_t shift{ static_cast<uint32_t>(14 - halfExponent) };
+			const uint32_t rounded{ (mantissa + (1u << (shift - 1))) >> shift };
+			return static_cast<uint16_t>(sign | rounded);
+		}
+
+		// Round to nearest, a mantissa overflow correctly carries into the exponent
+		const uint32_t half{ (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13) };
+		return static_cast<uint16_t>(sign | (half + ((mantissa >> 12) & 1)));
+	}
+
+	float VertexPacking::HalfToFloat(uint16_t half)
+	{
+		return _mm_cvtss_f32(HalfToFloat4(_mm_cvtsi32_si128(half)));
+	}
+
+	uint32_t VertexPacking::EncodeOctahedral(const Vector3& direction)
+	{
+		const float sum{ abs(direction.x) + abs(direction.y) + abs(direction.z) };
+		if (sum <= FLT_MIN)
+			return 0;
+
+		float x{ direction.x / sum };
+		float y{ direction.y / sum };
+		if (direction.z < 0.f)
+		{
+			const float foldedX{ (1.f - abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+			const float foldedY{ (1.f - abs(x)) * (y >= 0.f ? 1.f : -1.f) };
+			x = foldedX;
+			y = foldedY;
+		}
+
+		return static_cast<uint16_t>(ToSnorm16(x)) | (static_cast<uint32_t>(static_cast<uint16_t>(ToSnorm16(y))) << 16);
+	}
+
+	Vector3 VertexPacking::DecodeOctahedral(uint32_t encoded)
+	{
+		Vector3 result{};
+		Vector3 unused{};
+		DecodeOctahedral2(encoded, encoded, result, unused);
+		return result;
+	}
+
+	PackedVertex VertexPacking::Pack(const Vertex& vertex, const VertexQuantization& quantization)
+	{
+		PackedVertex packed{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float scale{ quantization.scale[axis] };
+			const float normalized{ scale > 0.f ? (vertex.position[axis] - quantization.offset[axis]) / scale : 0.f };
+			packed.position[axis] = static_cast<uint16_t>(std::clamp(std::lround(normalized), 0l, 65535l));
+		}
+
+		packed.uv[0] = FloatToHalf(vertex.uv.x);
+		packed.uv[1] = FloatToHalf(vertex.uv.y);
+		packed.normal = EncodeOctahedral(vertex.normal);
+		packed.tangent = EncodeOctahedral(vertex.tangent);
+		packed.color = ToUnorm8(vertex.color.r)
+			| ToUnorm8(vertex.color.g) << 8
+			| ToUnorm8(vertex.color.b) << 16
+			| 0xffu << 24;
+
+		return packed;
+	}
+
+	void VertexPacking::PackMesh(Mesh& mesh)
+	{
+		const std::span<const Vertex> vertices{ mesh.GetVertices() };
+		if (vertices.empty())
+			return;
+
+		Vector3 minBounds{ vertices[0].position };
+		Vector3 maxBounds{ vertices[0].position };
+		for (const Vertex& vertex : vertices)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				minBounds[axis] = std::min(minBounds[axis], vertex.position[axis]);
+				maxBounds[axis] = std::max(maxBounds[axis], vertex.position[axis]);
+			}
+		}
+
+		mesh.quantization.offset = minBounds;
+		mesh.quantization.scale = (maxBounds - minBounds) / 65535.f;
+
+		mesh.packedVertices.resize(vertices.size());
+		for (size_t idx{}; idx < vertices.size(); ++idx)
+			mesh.packedVertices[idx] = Pack(vertices[idx], mesh.quantization);
+
+		mesh.vertices.clear();
+		mesh.vertices.shrink_to_fit();
+	}
+
+	void VertexPacking::Decode(const PackedVertex* pPacked, size_t count, const VertexQuantization& quantization, Vertex* pOut)
+	{
+		const __m128 offset{ _mm_setr_ps(quantization.offset.x, quantization.offset.y, quantization.offset.z, 0.f) };
+		const __m128 scale{ _mm_setr_ps(quantization.scale.x, quantization.scale.y, quantization.scale.z, 0.f) };
+		const __m128 toUnit{ _mm_set1_ps(1.f / 255.f) };
+		const __m128i zero{ _mm_setzero_si128() };
+
+		alignas(16) float position[4];
+		alignas(16) float uv[4];
+		alignas(16) float color[4];
+
+		for (size_t idx{}; idx < count; ++idx)
+		{
+			const PackedVertex& packed{ pPacked[idx] };
+			Vertex& out{ pOut[idx] };
+
+			// position[0..2] and uv[0] live in the first 8 bytes
+			const __m128i positionUv{ _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(packed.position)), zero) };
+			_mm_store_ps(position, _mm_add_ps(offset, _mm_mul_ps(_mm_cvtepi32_ps(positionUv), scale)));
+
+			int32_t rawUv{};
+			std::memcpy(&rawUv, packed.uv, sizeof(rawUv));
+			_mm_store_ps(uv, HalfToFloat4(_mm_unpacklo_epi16(_mm_cvtsi32_si128(rawUv), zero)));
+
+			const __m128i colorBytes{ _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(packed.color)), zero), zero) };
+			_mm_store_ps(color, _mm_mul_ps(_mm_cvtepi32_ps(colorBytes), toUnit));
+
+			out.position = { position[0], position[1], position[2] };
+			out.uv = { uv[0], uv[1] };
+			out.color = { color[0], color[1], color[2] };
+			DecodeOctahedral2(packed.normal, packed.tangent, out.normal, out.tangent);
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace dae
+{
+	struct Mesh;
+	struct PackedVertex;
+	struct Vertex;
+	struct VertexQuantization;
+	struct Vector2;
+	struct Vector3;
+
+	namespace VertexPacking
+	{
+		uint16_t FloatToHalf(float value);
+		float HalfToFloat(uint16_t half);
+
+		// Octahedral mapping of a unit vector, packed as two snorm16 (x in the low bits)
+		uint32_t EncodeOctahedral(const Vector3& direction);
+		Vector3 DecodeOctahedral(uint32_t encoded);
+
+		PackedVertex Pack(const Vertex& vertex, const VertexQuantization& quantization);
+
+		// Fills Mesh::packedVertices and Mesh::quantization from the full vertices.
+		// Releases the owned full vertices, mapped ones are left alone
+		void PackMesh(Mesh& mesh);
+
+		// SSE2 decode of count vertices, used by the vertex stage on small batches that stay in L1.
+		// Max error: positions half a quantization step (bounds / 65535), normals/tangents ~1e-4, uvs half float rounding
+		void Decode(const PackedVertex* pPacked, size_t count, const VertexQuantization& quantization, Vertex* pOut);
+	}
+}
@@ -0,0 +1,241 @@
+#include "DepthBuffer.h"
+#include "TiledFramebuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+using namespace dae;
+
+DepthBuffer::DepthBuffer(int width, int height)
+	: m_Width{ (width + 3) & ~3 }
+	, m_Height{ height }
+	, m_Depth(static_cast<size_t>(m_Width) * height, FLT_MAX)
+{
+}
+
+void DepthBuffer::Clear()
+{
+	std::fill(m_Depth.begin(), m_Depth.end(), FLT_MAX);
+}
+
+void DepthBuffer::RasterizeTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2, int firstRow, int endRow)
+{
+	const auto isOutsideDepth = [](const Vector4& position) { return position.z < 0.f || position.z > 1.f; };
+	if (isOutsideDepth(v0) || isOutsideDepth(v1) || isOutsideDepth(v2))
+		return;
+
+	const Vector2 p0{ v0.x, v0.y };
+	const Vector2 p1{ v1.x, v1.y };
+	const Vector2 p2{ v2.x, v2.y };
+
+	const float areaTrig{ Vector2::Cross(p1 - p0, p2 - p0) };
+	if (areaTrig <= 0.f)
+		return;
+
+	// Clamped as floats first, so far away vertices can't overflow
+	const float minRow{ static_cast<float>(std::max(firstRow, 0)) };
+	const float maxRow{ static_cast<float>(std::min(endRow, m_Height)) };
+	const int startX{ static_cast<int>(std::floor(std::clamp(std::min({ p0.x, p1.x, p2.x }), 0.f, static_cast<float>(m_Width)))) & ~3 };
+	const int startY{ static_cast<int>(std::floor(std::clamp(std::min({ p0.y, p1.y, p2.y }), minRow, maxRow))) };
+	const int endX{ static_cast<int>(std::ceil(std::clamp(std::max({ p0.x, p1.x, p2.x }), 0.f, static_cast<float>(m_Width)))) };
+	const int endY{ static_cast<int>(std::ceil(std::clamp(std::max({ p0.y, p1.y, p2.y }), minRow, maxRow))) };
+	if (startX >= endX || startY >= endY)
+		return;
+	const float invAreaTrig{ 1.f / areaTrig };
+
+	// Same weights as the color pass, Cross(b - a, pixel - a), written as a * x + b * y + c so they step linearly
+	struct EdgeFunction
+	{
+		float a{};
+		float b{};
+		float c{};
+	};
+	const auto createEdge = [invAreaTrig](const Vector2& from, const Vector2& to)
+	{
+		const Vector2 edge{ to - from };
+		return EdgeFunction{ -edge.y * invAreaTrig, edge.x * invAreaTrig, (edge.y * from.x - edge.x * from.y) * invAreaTrig };
+	};
+	const EdgeFunction edge0{ createEdge(p1, p2) };
+	const EdgeFunction edge1{ createEdge(p2, p0) };
+	const EdgeFunction edge2{ createEdge(p0, p1) };
+
+	// NDC depth is linear in screen space, so it is an edge-like plane as well
+	const float depthA{ edge0.a * v0.z + edge1.a * v1.z + edge2.a * v2.z };
+	const float depthB{ edge0.b * v0.z + edge1.b * v1.z + edge2.b * v2.z };
+	const float depthC{ edge0.c * v0.z + edge1.c * v1.z + edge2.c * v2.z };
+
+	const __m128 laneOffsets{ _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f) };
+	const __m128 zero{ _mm_setzero_ps() };
+
+	// The pixel centers at the corners of a block, as x0 x1 x0 x1 and y0 y0 y1 y1
+	const auto getBlockWeights = [](const EdgeFunction& edge, const __m128& cornerX, const __m128& cornerY)
+	{
+		// Same operations as the per pixel weights below, rounding keeps the corners their exact bounds
+		const __m128 cornerRow{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge.b), cornerY), _mm_set1_ps(edge.c)) };
+		return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge.a), cornerX), cornerRow);
+	};
+
+	// Blocks outside an edge are skipped, blocks inside all three skip the per pixel coverage test.
+	// Triangles within a single block go straight to the per pixel test. Columns stay multiples of 4 within the rounded up width
+	const int blockEndX{ std::min((endX + 3) & ~3, m_Width) };
+	const bool isBlockTested{ blockEndX - startX > BLOCK_SIZE || endY - startY > BLOCK_SIZE };
+	for (int blockY{ startY }; blockY < endY; blockY += BLOCK_SIZE)
+	{
+		const int blockMaxY{ std::min(blockY + BLOCK_SIZE, endY) };
+		for (int blockX{ startX }; blockX < blockEndX; blockX += BLOCK_SIZE)
+		{
+			const int blockMaxX{ std::min(blockX + BLOCK_SIZE, blockEndX) };
+
+			bool isBlockInside{ false };
+			if (isBlockTested)
+			{
+				const float firstCenterX{ blockX + 0.5f };
+				const float lastCenterX{ blockMaxX - 0.5f };
+				const float firstCenterY{ blockY + 0.5f };
+				const float lastCenterY{ blockMaxY - 0.5f };
+				const __m128 cornerX{ _mm_setr_ps(firstCenterX, lastCenterX, firstCenterX, lastCenterX) };
+				const __m128 cornerY{ _mm_setr_ps(firstCenterY, firstCenterY, lastCenterY, lastCenterY) };
+				const int cornersInside0{ _mm_movemask_ps(_mm_cmpge_ps(getBlockWeights(edge0, cornerX, cornerY), zero)) };
+				const int cornersInside1{ _mm_movemask_ps(_mm_cmpge_ps(getBlockWeights(edge1, cornerX, cornerY), zero)) };
+				const int cornersInside2{ _mm_movemask_ps(_mm_cmpge_ps(getBlockWeights(edge2, cornerX, cornerY), zero)) };
+				if (cornersInside0 == 0 || cornersInside1 == 0 || cornersInside2 == 0)
+					continue;
+				isBlockInside = (cornersInside0 & cornersInside1 & cornersInside2) == 0xF;
+			}
+
+			for (int py{ blockY }; py < blockMaxY; ++py)
+			{
+				const float screenY{ py + 0.5f };
+				const __m128 rowWeight0{ _mm_set1_ps(edge0.b * screenY + edge0.c) };
+				const __m128 rowWeight1{ _mm_set1_ps(edge1.b * screenY + edge1.c) };
+				const __m128 rowWeight2{ _mm_set1_ps(edge2.b * screenY + edge2.c) };
+				const __m128 rowDepth{ _mm_set1_ps(depthB * screenY + depthC) };
+
+				// Rows start 16 byte aligned, the width is a multiple of 4 and x64 heap allocations are 16 byte aligned
+				float* pRow{ &m_Depth[static_cast<size_t>(py) * m_Width] };
+				for (int px{ blockX }; px < blockMaxX; px += 4)
+				{
+					const __m128 screenX{ _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), laneOffsets) };
+
+					__m128 isInside{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+					if (!isBlockInside)
+					{
+						const __m128 weight0{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge0.a), screenX), rowWeight0) };
+						const __m128 weight1{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge1.a), screenX), rowWeight1) };
+						const __m128 weight2{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge2.a), screenX), rowWeight2) };
+						isInside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(weight0, zero), _mm_cmpge_ps(weight1, zero)), _mm_cmpge_ps(weight2, zero));
+						if (_mm_movemask_ps(isInside) == 0)
+							continue;
+					}
+
+					const __m128 pixelDepth{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), screenX), rowDepth) };
+					const __m128 storedDepth{ _mm_load_ps(pRow + px) };
+					const __m128 isWritten{ _mm_and_ps(isInside, _mm_cmple_ps(pixelDepth, storedDepth)) };
+
+					_mm_store_ps(pRow + px, _mm_or_ps(_mm_and_ps(isWritten, pixelDepth), _mm_andnot_ps(isWritten, storedDepth)));
+				}
+			}
+		}
+	}
+}
+
+float DepthBuffer::SampleShadow(float x, float y, float depth) const
+{
+	// 3x3 bilinear taps one pixel apart cover 4x4 pixels, the outer ones only as far as the taps reach into them
+	const float pixelX{ std::clamp(x, -2.f, m_Width + 2.f) - 0.5f };
+	const float pixelY{ std::clamp(y, -2.f, m_Height + 2.f) - 0.5f };
+	const float floorX{ std::floor(pixelX) };
+	const float floorY{ std::floor(pixelY) };
+	const float fractionX{ pixelX - floorX };
+	const float fractionY{ pixelY - floorY };
+	const int firstX{ static_cast<int>(floorX) - 1 };
+	const int firstY{ static_cast<int>(floorY) - 1 };
+
+	const __m128 weightsX{ _mm_setr_ps(1.f - fractionX, 1.f, 1.f, fractionX) };
+	const float weightsY[4]{ 1.f - fractionY, 1.f, 1.f, fractionY };
+	const __m128 testDepth{ _mm_set1_ps(depth) };
+	const bool isInsideRow{ firstX >= 0 && firstX + 4 <= m_Width };
+
+	__m128 lit{ _mm_setzero_ps() };
+	for (int row{}; row < 4; ++row)
+	{
+		const float* pRow{ &m_Depth[static_cast<size_t>(std::clamp(firstY + row, 0, m_Height - 1)) * m_Width] };
+		__m128 storedDepth{};
+		if (isInsideRow)
+		{
+			storedDepth = _mm_loadu_ps(pRow + firstX);
+		}
+		else
+		{
+			const auto getDepth = [&](int offset) { return pRow[std::clamp(firstX + offset, 0, m_Width - 1)]; };
+			storedDepth = _mm_setr_ps(getDepth(0), getDepth(1), getDepth(2), getDepth(3));
+		}
+		const __m128 weights{ _mm_mul_ps(weightsX, _mm_set1_ps(weightsY[row])) };
+		lit = _mm_add_ps(lit, _mm_and_ps(_mm_cmpge_ps(storedDepth, testDepth), weights));
+	}
+
+	// The weights add up to 9
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, lit);
+	return (lanes[0] + lanes[1] + lanes[2] + lanes[3]) * (1.f / 9.f);
+}
+
+bool DepthBuffer::IsOccluded(int minX, int minY, int maxX, int maxY, float depth) const
+{
+	const __m128 testDepth{ _mm_set1_ps(depth) };
+
+	for (int py{ minY }; py < maxY; ++py)
+	{
+		const float* pRow{ &m_Depth[static_cast<size_t>(py) * m_Width] };
+
+		int px{ minX };
+		for (; px + 4 <= maxX; px += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(pRow + px), testDepth)) != 0xF)
+				return false;
+		}
+		for (; px < maxX; ++px)
+		{
+			if (!(pRow[px] < depth))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void DepthBuffer::DownsampleFrom(const TiledFramebuffer& source)
+{
+	const float* pSourceDepth{ source.GetDepth() };
+	const int sourceWidth{ source.GetWidth() };
+	const int sourceHeight{ source.GetHeight() };
+	const float scaleX{ static_cast<float>(sourceWidth) / m_Width };
+	const float scaleY{ static_cast<float>(sourceHeight) / m_Height };
+
+	for (int py{}; py < m_Height; ++py)
+	{
+		const int sourceStartY{ static_cast<int>(std::floor(py * scaleY)) };
+		const int sourceEndY{ std::min(static_cast<int>(std::ceil((py + 1) * scaleY)), sourceHeight) };
+
+		for (int px{}; px < m_Width; ++px)
+		{
+			const int sourceStartX{ static_cast<int>(std::floor(px * scaleX)) };
+			const int sourceEndX{ std::min(static_cast<int>(std::ceil((px + 1) * scaleX)), sourceWidth) };
+
+			float farthest{ 0.f };
+			for (int sy{ sourceStartY }; sy < sourceEndY; ++sy)
+			{
+				for (int sx{ sourceStartX }; sx < sourceEndX; ++sx)
+					farthest = std::max(farthest, pSourceDepth[source.GetPixelIdx(sx, sy)]);
+			}
+			m_Depth[px + static_cast<size_t>(py) * m_Width] = farthest;
+		}
+	}
+}
+
+void DepthBuffer::SetDepthIfFarther(int x, int y, float depth)
+{
+	float& storedDepth{ m_Depth[x + static_cast<size_t>(y) * m_Width] };
+	storedDepth = storedDepth == FLT_MAX ? depth : std::max(storedDepth, depth);
+}
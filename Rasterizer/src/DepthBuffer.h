@@ -0,0 +1,58 @@
+#pragma once
+
+#include <climits>
+#include <vector>
+
+#include "Maths.h"
+
+namespace dae
+{
+	class TiledFramebuffer;
+
+	// Depth only render target with an SSE rasterizer, 4 pixels of a row at a time.
+	// Stores NDC depth like the main depth buffer, smaller is closer and FLT_MAX is empty
+	class DepthBuffer final
+	{
+	public:
+		// The width gets rounded up to a multiple of 4 so rows can always be processed in full SIMD lanes
+		DepthBuffer(int width, int height);
+		~DepthBuffer() = default;
+
+		DepthBuffer(const DepthBuffer&) = delete;
+		DepthBuffer(DepthBuffer&&) noexcept = delete;
+		DepthBuffer& operator=(const DepthBuffer&) = delete;
+		DepthBuffer& operator=(DepthBuffer&&) noexcept = delete;
+
+		void Clear();
+
+		// Positions are in this buffer's pixels with NDC depth in z, same culling rules as the color pass:
+		// back-facing triangles and triangles with a vertex outside the depth range are skipped.
+		// Only rows in [firstRow, endRow) get written, so separate bands of rows can be rasterized in parallel
+		void RasterizeTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2, int firstRow = 0, int endRow = INT_MAX);
+
+		// True when every pixel in [minX, maxX) x [minY, maxY) is closer than depth
+		bool IsOccluded(int minX, int minY, int maxX, int maxY, float depth) const;
+
+		// Keeps the farthest depth of every block of source pixels a pixel of this buffer covers, so nothing ends up closer than it was
+		void DownsampleFrom(const TiledFramebuffer& source);
+
+		// Used as a shadow map: the lit fraction of a 3x3 bilinear PCF kernel around pixel position (x, y),
+		// where a sample is lit when its stored depth is at or beyond depth. Samples past the edges repeat the edge pixels
+		float SampleShadow(float x, float y, float depth) const;
+
+		float GetDepth(int x, int y) const { return m_Depth[x + y * m_Width]; }
+		// An empty pixel takes depth as is, a written one only keeps the farther of both
+		void SetDepthIfFarther(int x, int y, float depth);
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+	private:
+		// RasterizeTriangle tests the corners of blocks this size before their pixels
+		static constexpr int BLOCK_SIZE{ 8 };
+
+		int m_Width{};
+		int m_Height{};
+		std::vector<float> m_Depth{};
+	};
+}
@@ -0,0 +1,42 @@
+#include "PixelShading.h"
+
+#include <array>
+#include <utility>
+
+using namespace dae;
+
+namespace
+{
+	template<uint32_t... ConfigIndices>
+	constexpr std::array<PixelShading::ShadeFunction, sizeof...(ConfigIndices)> CreateShadeFunctions(std::integer_sequence<uint32_t, ConfigIndices...>)
+	{
+		return { &PixelShading::ShadeQuad<PixelShading::GetShaderConfig(ConfigIndices)>... };
+	}
+
+	constexpr std::array<PixelShading::ShadeFunction, PixelShading::NR_SHADER_CONFIGS> SHADE_FUNCTIONS{
+		CreateShadeFunctions(std::make_integer_sequence<uint32_t, PixelShading::NR_SHADER_CONFIGS>{})
+	};
+}
+
+uint32_t PixelShading::GetShaderConfigIdx(const Material& material, ShadingMode mode, bool isNormalMapEnabled, bool isShadowMapEnabled)
+{
+	uint32_t configIdx{ static_cast<uint32_t>(mode) << 6 };
+	if (material.pDiffuse)
+		configIdx |= 1;
+	if (isNormalMapEnabled && material.pNormal)
+		configIdx |= 2;
+	if (material.pSpecular)
+		configIdx |= 4;
+	if (material.pGloss)
+		configIdx |= 8;
+	if (material.isFastMathAllowed)
+		configIdx |= 16;
+	if (isShadowMapEnabled)
+		configIdx |= 32;
+	return configIdx;
+}
+
+PixelShading::ShadeFunction PixelShading::GetShadeFunction(uint32_t configIdx)
+{
+	return SHADE_FUNCTIONS[configIdx];
+}
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <cmath>
+#include <emmintrin.h>
+#include <span>
+
+#include "DataTypes.h"
+#include "DepthBuffer.h"
+#include "FastMath.h"
+#include "Maths.h"
+#include "RenderSettings.h"
+#include "Scene.h"
+#include "Texture.h"
+
+namespace dae
+{
+	// Lighting that stays the same for a whole frame, in view space like the vertices
+	struct ShadingConstants
+	{
+		// Normalized, from the light into the scene
+		Vector3 lightDirection{};
+		// Light color times its intensity
+		ColorRGB lightColor{};
+		ColorRGB ambientColor{};
+
+		// Depth from the directional light, only read by configs with ShaderConfig::isShadowed
+		const DepthBuffer* pShadowMap{};
+		// View space to shadow map pixels, with the shadow map depth in z
+		Matrix viewToShadow{};
+		// View space distance the shadow lookup moves along the vertex normal, and shadow map depth it moves towards the light,
+		// so lit surfaces don't shadow themselves
+		float shadowNormalOffset{};
+		float shadowDepthBias{};
+	};
+
+	// A Scene::PointLight in view space
+	struct ShadingPointLight
+	{
+		Vector3 position{};
+		float invRadiusSquared{};
+		// Light color times its intensity
+		ColorRGB color{};
+	};
+
+	// One color per SSE lane
+	struct ColorQuad
+	{
+		__m128 r{};
+		__m128 g{};
+		__m128 b{};
+	};
+
+	// Screen space barycentric weights of 4 pixels. A struct, so function pointer types taking it keep the vector alignment
+	struct WeightQuad
+	{
+		__m128 weight0{};
+		__m128 weight1{};
+		__m128 weight2{};
+	};
+
+	// Everything ShadeQuad would otherwise test per pixel, as a template argument.
+	// Features a mode doesn't use are always false, so those materials share one instantiation
+	struct ShaderConfig
+	{
+		ShadingMode mode{ ShadingMode::Unlit };
+		// Material::pDiffuse instead of the vertex color
+		bool isTextured{ false };
+		// Material::pNormal, only when RenderSettings::isNormalMapEnabled
+		bool isNormalMapped{ false };
+		// Material::pSpecular, without it there is no highlight
+		bool isSpecular{ false };
+		// Material::pGloss scales the shininess
+		bool isGlossMapped{ false };
+		// Material::isFastMathAllowed, reciprocals, normalization and pow go through FastMath
+		bool isFastMath{ false };
+		// ShadingConstants::pShadowMap darkens the directional light
+		bool isShadowed{ false };
+	};
+
+	namespace PixelShading
+	{
+		constexpr uint32_t NR_SHADING_MODES{ static_cast<uint32_t>(ShadingMode::Combined) + 1 };
+		// Every mode with every combination of the 5 material features and shadows
+		constexpr uint32_t NR_SHADER_CONFIGS{ NR_SHADING_MODES << 6 };
+
+		constexpr ShaderConfig GetShaderConfig(uint32_t configIdx)
+		{
+			ShaderConfig config{};
+			config.mode = static_cast<ShadingMode>(configIdx >> 6);
+
+			const bool usesAlbedo{ config.mode == ShadingMode::Unlit || config.mode == ShadingMode::Diffuse || config.mode == ShadingMode::Combined };
+			const bool usesSpecular{ config.mode == ShadingMode::Specular || config.mode == ShadingMode::Combined };
+			config.isTextured = usesAlbedo && (configIdx & 1);
+			config.isNormalMapped = config.mode != ShadingMode::Unlit && (configIdx & 2);
+			config.isSpecular = usesSpecular && (configIdx & 4);
+			config.isGlossMapped = config.isSpecular && (configIdx & 8);
+			config.isFastMath = configIdx & 16;
+			// The observed area view shows the bare cosine
+			config.isShadowed = (config.mode == ShadingMode::Diffuse || config.mode == ShadingMode::Specular || config.mode == ShadingMode::Combined) && (configIdx & 32);
+
+			// Only black is left to shade
+			if (config.mode == ShadingMode::Specular && !config.isSpecular)
+			{
+				config.isNormalMapped = false;
+				config.isShadowed = false;
+			}
+			return config;
+		}
+
+		// Looked up once per draw, the result indexes the instantiations through GetShaderConfig
+		uint32_t GetShaderConfigIdx(const Material& material, ShadingMode mode, bool isNormalMapEnabled, bool isShadowMapEnabled);
+
+		// A quad of view space vectors, one per lane
+		struct Vector3Quad
+		{
+			__m128 x{};
+			__m128 y{};
+			__m128 z{};
+		};
+
+		inline __m128 Dot(const Vector3Quad& a, const Vector3Quad& b)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+		}
+
+		inline Vector3Quad Cross(const Vector3Quad& a, const Vector3Quad& b)
+		{
+			return {
+				_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+				_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+				_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+			};
+		}
+
+		// Same as Matrix::TransformPoint, rows are the axes
+		inline Vector3Quad TransformPoint(const Matrix& matrix, const Vector3Quad& p)
+		{
+			const Vector4 xAxis{ matrix[0] };
+			const Vector4 yAxis{ matrix[1] };
+			const Vector4 zAxis{ matrix[2] };
+			const Vector4 translation{ matrix[3] };
+			const auto transform = [&p](float x, float y, float z, float t)
+			{
+				return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p.x, _mm_set1_ps(x)), _mm_mul_ps(p.y, _mm_set1_ps(y))), _mm_mul_ps(p.z, _mm_set1_ps(z))), _mm_set1_ps(t));
+			};
+			return {
+				transform(xAxis.x, yAxis.x, zAxis.x, translation.x),
+				transform(xAxis.y, yAxis.y, zAxis.y, translation.y),
+				transform(xAxis.z, yAxis.z, zAxis.z, translation.z)
+			};
+		}
+
+		// Lit fraction of every lane's view space position
+		inline __m128 SampleShadow(const ShadingConstants& constants, const Vector3Quad& position)
+		{
+			const Vector3Quad shadowPosition{ TransformPoint(constants.viewToShadow, position) };
+			alignas(16) float x[4];
+			alignas(16) float y[4];
+			alignas(16) float depth[4];
+			_mm_store_ps(x, shadowPosition.x);
+			_mm_store_ps(y, shadowPosition.y);
+			_mm_store_ps(depth, _mm_sub_ps(shadowPosition.z, _mm_set1_ps(constants.shadowDepthBias)));
+
+			const DepthBuffer& shadowMap{ *constants.pShadowMap };
+			return _mm_setr_ps(shadowMap.SampleShadow(x[0], y[0], depth[0]), shadowMap.SampleShadow(x[1], y[1], depth[1]),
+				shadowMap.SampleShadow(x[2], y[2], depth[2]), shadowMap.SampleShadow(x[3], y[3], depth[3]));
+		}
+
+		template<bool IsFastMath>
+		__m128 InvSqrt(__m128 a)
+		{
+			if constexpr (IsFastMath)
+				return FastMath::Rsqrt(a);
+			else
+				return _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(a));
+		}
+
+		template<bool IsFastMath>
+		Vector3Quad Normalize(const Vector3Quad& v)
+		{
+			const __m128 invLength{ InvSqrt<IsFastMath>(Dot(v, v)) };
+			return { _mm_mul_ps(v.x, invLength), _mm_mul_ps(v.y, invLength), _mm_mul_ps(v.z, invLength) };
+		}
+
+		// Exact pow has no SSE version, so it is std::pow per lane
+		template<bool IsFastMath>
+		__m128 Pow(__m128 base, __m128 exponent)
+		{
+			if constexpr (IsFastMath)
+			{
+				return FastMath::Pow(base, exponent);
+			}
+			else
+			{
+				alignas(16) float bases[4];
+				alignas(16) float exponents[4];
+				_mm_store_ps(bases, base);
+				_mm_store_ps(exponents, exponent);
+				return _mm_setr_ps(std::pow(bases[0], exponents[0]), std::pow(bases[1], exponents[1]), std::pow(bases[2], exponents[2]), std::pow(bases[3], exponents[3]));
+			}
+		}
+
+		// Perspective correct interpolation, attribute / viewDepth is linear in screen space
+		struct Interpolator
+		{
+			__m128 correction0{};
+			__m128 correction1{};
+			__m128 correction2{};
+			__m128 viewDepth{};
+
+			// Same operation order as interpolating one pixel at a time, so unlit colors match it exactly
+			__m128 operator()(float value0, float value1, float value2) const
+			{
+				const __m128 sum{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(value0), correction0), _mm_mul_ps(_mm_set1_ps(value1), correction1)),
+					_mm_mul_ps(_mm_set1_ps(value2), correction2)) };
+				return _mm_mul_ps(sum, viewDepth);
+			}
+
+			Vector3Quad operator()(const Vector3& value0, const Vector3& value1, const Vector3& value2) const
+			{
+				return { (*this)(value0.x, value1.x, value2.x), (*this)(value0.y, value1.y, value2.y), (*this)(value0.z, value1.z, value2.z) };
+			}
+		};
+
+		// Shades 4 pixels of the triangle v0 v1 v2 at once: weights holds their screen space barycentric weights,
+		// invDepths holds 1 / viewDepth of every vertex. The material has to have every map Config uses.
+		// pointLights only needs the lights that can reach these pixels. Colors can go past 1, the caller clamps them
+		template<ShaderConfig Config>
+		ColorQuad ShadeQuad(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, const Vector3& invDepths, const Material& material,
+			const ShadingConstants& constants, std::span<const ShadingPointLight> pointLights, const WeightQuad& weights)
+		{
+			Interpolator interpolate{};
+			interpolate.correction0 = _mm_mul_ps(weights.weight0, _mm_set1_ps(invDepths.x));
+			interpolate.correction1 = _mm_mul_ps(weights.weight1, _mm_set1_ps(invDepths.y));
+			interpolate.correction2 = _mm_mul_ps(weights.weight2, _mm_set1_ps(invDepths.z));
+			const __m128 invViewDepth{ _mm_add_ps(_mm_add_ps(interpolate.correction0, interpolate.correction1), interpolate.correction2) };
+			if constexpr (Config.isFastMath)
+				interpolate.viewDepth = FastMath::Rcp(invViewDepth);
+			else
+				interpolate.viewDepth = _mm_div_ps(_mm_set1_ps(1.f), invViewDepth);
+
+			const __m128 u{ interpolate(v0.uv.x, v1.uv.x, v2.uv.x) };
+			const __m128 v{ interpolate(v0.uv.y, v1.uv.y, v2.uv.y) };
+
+			ColorQuad albedo{};
+			if constexpr (Config.isTextured)
+				material.pDiffuse->Sample(u, v, albedo.r, albedo.g, albedo.b);
+			else
+				albedo = { interpolate(v0.color.r, v1.color.r, v2.color.r), interpolate(v0.color.g, v1.color.g, v2.color.g), interpolate(v0.color.b, v1.color.b, v2.color.b) };
+
+			if constexpr (Config.mode == ShadingMode::Unlit)
+				return albedo;
+
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 two{ _mm_set1_ps(2.f) };
+
+			Vector3Quad normal{ Normalize<Config.isFastMath>(interpolate(v0.normal, v1.normal, v2.normal)) };
+			const Vector3Quad vertexNormal{ normal };
+			if constexpr (Config.isNormalMapped)
+			{
+				const Vector3Quad tangent{ Normalize<Config.isFastMath>(interpolate(v0.tangent, v1.tangent, v2.tangent)) };
+				const Vector3Quad binormal{ Cross(normal, tangent) };
+
+				// [0, 1] texels to a [-1, 1] tangent space direction
+				Vector3Quad sampled{};
+				material.pNormal->Sample(u, v, sampled.x, sampled.y, sampled.z);
+				sampled = { _mm_sub_ps(_mm_mul_ps(sampled.x, two), one), _mm_sub_ps(_mm_mul_ps(sampled.y, two), one), _mm_sub_ps(_mm_mul_ps(sampled.z, two), one) };
+
+				normal = Normalize<Config.isFastMath>({
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(tangent.x, sampled.x), _mm_mul_ps(binormal.x, sampled.y)), _mm_mul_ps(normal.x, sampled.z)),
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(tangent.y, sampled.x), _mm_mul_ps(binormal.y, sampled.y)), _mm_mul_ps(normal.y, sampled.z)),
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(tangent.z, sampled.x), _mm_mul_ps(binormal.z, sampled.y)), _mm_mul_ps(normal.z, sampled.z))
+				});
+			}
+
+			// Towards the light
+			const Vector3Quad toLight{ _mm_set1_ps(-constants.lightDirection.x), _mm_set1_ps(-constants.lightDirection.y), _mm_set1_ps(-constants.lightDirection.z) };
+			const __m128 observedArea{ _mm_max_ps(Dot(normal, toLight), zero) };
+			if constexpr (Config.mode == ShadingMode::ObservedArea)
+				return { observedArea, observedArea, observedArea };
+
+			constexpr bool isDiffuse{ Config.mode == ShadingMode::Diffuse || Config.mode == ShadingMode::Combined };
+			ColorQuad radiance{ zero, zero, zero };
+			if constexpr (!isDiffuse && !Config.isSpecular)
+				return radiance;
+
+			// The surface's response, the same for every light
+			const Vector3Quad position{ interpolate(v0.viewDirection, v1.viewDirection, v2.viewDirection) };
+			Vector3Quad viewDirection{};
+			__m128 exponent{ _mm_set1_ps(material.shininess) };
+			ColorQuad specular{};
+			if constexpr (Config.isSpecular)
+			{
+				viewDirection = Normalize<Config.isFastMath>(position);
+				if constexpr (Config.isGlossMapped)
+				{
+					__m128 gloss{};
+					__m128 unusedG{};
+					__m128 unusedB{};
+					material.pGloss->Sample(u, v, gloss, unusedG, unusedB);
+					exponent = _mm_mul_ps(exponent, gloss);
+				}
+				material.pSpecular->Sample(u, v, specular.r, specular.g, specular.b);
+			}
+
+			// Lambert and Blinn-Phong for light coming from direction, the terms get scaled by their own irradiance
+			const auto addLight = [&](const Vector3Quad& direction, const __m128 cosine, const ColorQuad& diffuseIrradiance, const ColorQuad& specularIrradiance)
+			{
+				if constexpr (isDiffuse)
+				{
+					// Lambert, albedo / PI
+					const __m128 scale{ _mm_mul_ps(cosine, _mm_set1_ps(1.f / PI)) };
+					radiance.r = _mm_add_ps(radiance.r, _mm_mul_ps(_mm_mul_ps(albedo.r, diffuseIrradiance.r), scale));
+					radiance.g = _mm_add_ps(radiance.g, _mm_mul_ps(_mm_mul_ps(albedo.g, diffuseIrradiance.g), scale));
+					radiance.b = _mm_add_ps(radiance.b, _mm_mul_ps(_mm_mul_ps(albedo.b, diffuseIrradiance.b), scale));
+				}
+
+				if constexpr (Config.isSpecular)
+				{
+					// Blinn-Phong, halfway between the directions to the light and to the camera
+					const Vector3Quad halfVector{ Normalize<Config.isFastMath>({ _mm_sub_ps(direction.x, viewDirection.x), _mm_sub_ps(direction.y, viewDirection.y), _mm_sub_ps(direction.z, viewDirection.z) }) };
+					const __m128 highlight{ _mm_mul_ps(Pow<Config.isFastMath>(_mm_max_ps(Dot(normal, halfVector), zero), exponent), cosine) };
+					radiance.r = _mm_add_ps(radiance.r, _mm_mul_ps(_mm_mul_ps(specular.r, specularIrradiance.r), highlight));
+					radiance.g = _mm_add_ps(radiance.g, _mm_mul_ps(_mm_mul_ps(specular.g, specularIrradiance.g), highlight));
+					radiance.b = _mm_add_ps(radiance.b, _mm_mul_ps(_mm_mul_ps(specular.b, specularIrradiance.b), highlight));
+				}
+			};
+
+			__m128 directionalCosine{ observedArea };
+			if constexpr (Config.isShadowed)
+			{
+				const __m128 offset{ _mm_set1_ps(constants.shadowNormalOffset) };
+				const Vector3Quad shadowPosition{ _mm_add_ps(position.x, _mm_mul_ps(vertexNormal.x, offset)), _mm_add_ps(position.y, _mm_mul_ps(vertexNormal.y, offset)),
+					_mm_add_ps(position.z, _mm_mul_ps(vertexNormal.z, offset)) };
+				directionalCosine = _mm_mul_ps(directionalCosine, SampleShadow(constants, shadowPosition));
+			}
+
+			// The directional highlight isn't scaled by the light intensity, the specular map already holds its strength
+			const ColorQuad directionalIrradiance{ _mm_set1_ps(constants.lightColor.r), _mm_set1_ps(constants.lightColor.g), _mm_set1_ps(constants.lightColor.b) };
+			addLight(toLight, directionalCosine, directionalIrradiance, { one, one, one });
+
+			for (const ShadingPointLight& light : pointLights)
+			{
+				const Vector3Quad toPointLight{ _mm_sub_ps(_mm_set1_ps(light.position.x), position.x), _mm_sub_ps(_mm_set1_ps(light.position.y), position.y),
+					_mm_sub_ps(_mm_set1_ps(light.position.z), position.z) };
+				const __m128 distanceSquared{ _mm_max_ps(Dot(toPointLight, toPointLight), _mm_set1_ps(1e-4f)) };
+				const __m128 invDistance{ InvSqrt<Config.isFastMath>(distanceSquared) };
+
+				// Inverse square falloff windowed by (1 - (distance / radius)^4)^2, which reaches 0 at the radius
+				const __m128 ratio{ _mm_mul_ps(distanceSquared, _mm_set1_ps(light.invRadiusSquared)) };
+				const __m128 window{ _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(ratio, ratio)), zero) };
+				const __m128 falloff{ _mm_mul_ps(_mm_mul_ps(window, window), _mm_mul_ps(invDistance, invDistance)) };
+
+				const Vector3Quad direction{ _mm_mul_ps(toPointLight.x, invDistance), _mm_mul_ps(toPointLight.y, invDistance), _mm_mul_ps(toPointLight.z, invDistance) };
+				const __m128 cosine{ _mm_max_ps(Dot(normal, direction), zero) };
+				const ColorQuad irradiance{ _mm_mul_ps(_mm_set1_ps(light.color.r), falloff), _mm_mul_ps(_mm_set1_ps(light.color.g), falloff),
+					_mm_mul_ps(_mm_set1_ps(light.color.b), falloff) };
+				addLight(direction, cosine, irradiance, irradiance);
+			}
+
+			if constexpr (Config.mode == ShadingMode::Combined)
+			{
+				radiance.r = _mm_add_ps(radiance.r, _mm_set1_ps(constants.ambientColor.r));
+				radiance.g = _mm_add_ps(radiance.g, _mm_set1_ps(constants.ambientColor.g));
+				radiance.b = _mm_add_ps(radiance.b, _mm_set1_ps(constants.ambientColor.b));
+			}
+			return radiance;
+		}
+
+		using ShadeFunction = ColorQuad(*)(const Vertex_Out&, const Vertex_Out&, const Vertex_Out&, const Vector3&,
+			const Material&, const ShadingConstants&, std::span<const ShadingPointLight>, const WeightQuad&);
+		// ShadeQuad for a config only known at runtime, for code that isn't instantiated per config itself
+		ShadeFunction GetShadeFunction(uint32_t configIdx);
+	}
+}
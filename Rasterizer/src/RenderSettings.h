@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+namespace dae
+{
+	enum class DrawSortMode
+	{
+		Submission,				// Instance order as it comes out of culling
+		FrontToBack,			// Nearest first, so hidden pixels fail the depth test before they get shaded
+		MaterialFrontToBack		// Grouped by Material::sortId, front-to-back inside every group
+	};
+
+	enum class ShadingMode
+	{
+		Unlit,			// Diffuse map or vertex color only
+		ObservedArea,	// Lambert cosine of the light on the surface
+		Diffuse,		// Lambert diffuse lighting
+		Specular,		// Blinn-Phong highlights only
+		Combined		// Diffuse, specular and ambient
+	};
+
+	// Runtime toggles, see Renderer::SetSettings
+	struct RenderSettings
+	{
+		static constexpr uint32_t MAX_FRAME_LATENCY{ 2 };
+
+		// Frames still rasterizing in the background when Render returns. 0 presents every frame right away,
+		// 1 or 2 bin the next frame while the earlier ones rasterize and get presented, at that many frames of latency
+		uint32_t frameLatency{ 0 };
+
+		DrawSortMode drawSortMode{ DrawSortMode::FrontToBack };
+
+		ShadingMode shadingMode{ ShadingMode::Combined };
+		// Uses Material::pNormal when there is one, the interpolated vertex normal otherwise
+		bool isNormalMapEnabled{ true };
+
+		// Shadows of the directional light from a depth only pass into a shadow map, softened with PCF
+		bool isShadowMapEnabled{ true };
+
+		// Every screen tile only shades the point lights whose sphere overlaps it and the depth of its surfaces,
+		// instead of every light on screen. The forward path starts from the depth range of every triangle binned to the tile
+		// and, without MSAA, runs an exact depth only pre-pass where that still leaves many lights
+		bool isLightCullingEnabled{ true };
+
+		// Times the depth only pre-pass and the color pass over the same binned triangles of every tile, see RenderStats.
+		// Forward path without MSAA only, where the pre-pass then also runs for tiles that don't need it for light culling
+		bool isRasterTimingEnabled{ false };
+
+		// 1 samples pixel centers only, 2, 4 or 8 keep depth per sample and shade once per pixel
+		uint32_t msaaSampleCount{ 1 };
+
+		// Rasterizes only depth and triangle ids, then shades every visible pixel once in a parallel screen space pass.
+		// Shading cost no longer grows with overdraw. Renders without MSAA
+		bool isVisibilityBufferEnabled{ false };
+
+		// Rasterizes the nearest occluders into a small depth buffer and skips the instances hidden behind them
+		bool isOcclusionCullingEnabled{ true };
+		// Also reprojects last frame's full depth into the occlusion buffer.
+		// Fast camera moves or moving instances can briefly hide things that just became visible
+		bool isTemporalOcclusionEnabled{ false };
+		uint32_t maxOccluders{ 8 };
+
+		// Picks the coarsest Mesh LOD whose simplification error stays below lodPixelError pixels on screen
+		bool isLodEnabled{ true };
+		float lodPixelError{ 1.f };
+		// A coarser LOD is only picked once its error is this fraction below the threshold, so instances at the boundary don't flip every frame
+		float lodHysteresis{ 0.25f };
+	};
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Per frame counters, reset at the start of every Render
+	struct RenderStats
+	{
+		uint32_t instancesTotal{};
+		uint32_t instancesDrawn{};
+		uint32_t instancesOccluded{};
+		uint32_t occludersDrawn{};
+		uint32_t shadowCasters{};
+		std::array<uint32_t, MAX_MESH_LODS> instancesPerLod{};
+
+		uint32_t bvhNodesVisited{};
+		uint32_t bvhNodesCulled{};
+
+		uint32_t meshletsTotal{};
+		uint32_t meshletsFrustumCulled{};
+		uint32_t meshletsConeCulled{};
+
+		uint32_t trianglesSmall{};
+		uint32_t trianglesWithoutCoverage{};
+		uint32_t blocksAccepted{};
+		uint32_t blocksPartial{};
+		uint32_t blocksRejected{};
+
+		// Overdraw is pixelsShaded / pixelsCovered, 1 means every shaded pixel survived
+		uint32_t pixelsShaded{};
+		uint32_t pixelsCovered{};
+
+		uint32_t pointLightsTotal{};
+		uint32_t pointLightsOnScreen{};
+		// Summed over every tile, so divided by tiles it is the average light list length
+		uint32_t tileLights{};
+		uint32_t tiles{};
+
+		// Only counted with RenderSettings::isRasterTimingEnabled. A triangle counts once for every tile it is binned to,
+		// the times are summed over the threads
+		uint32_t rasterTimedTriangles{};
+		uint64_t depthOnlyRasterNs{};
+		uint64_t colorRasterNs{};
+	};
+
+	inline std::ostream& operator<<(std::ostream& os, const RenderStats& stats)
+	{
+		os << "instances drawn: " << stats.instancesDrawn << '/' << stats.instancesTotal
+			<< " | occluded: " << stats.instancesOccluded << " behind " << stats.occludersDrawn << " occluders"
+			<< " | shadow casters: " << stats.shadowCasters
+			<< " | LODs:";
+		for (const uint32_t nrInstances : stats.instancesPerLod)
+			os << ' ' << nrInstances;
+		os << " | BVH nodes visited: " << stats.bvhNodesVisited << ", culled: " << stats.bvhNodesCulled
+			<< " | meshlets: " << stats.meshletsTotal << ", frustum culled: " << stats.meshletsFrustumCulled
+			<< ", cone culled: " << stats.meshletsConeCulled
+			<< " | small triangles: " << stats.trianglesSmall << ", between pixel centers: " << stats.trianglesWithoutCoverage
+			<< " | 8x8 blocks accepted: " << stats.blocksAccepted << ", partial: " << stats.blocksPartial << ", rejected: " << stats.blocksRejected
+			<< " | overdraw: " << (stats.pixelsCovered ? static_cast<float>(stats.pixelsShaded) / stats.pixelsCovered : 0.f)
+			<< " | point lights: " << stats.pointLightsOnScreen << '/' << stats.pointLightsTotal
+			<< ", per tile: " << (stats.tiles ? static_cast<float>(stats.tileLights) / stats.tiles : 0.f);
+		if (stats.rasterTimedTriangles)
+		{
+			os << " | ns per binned triangle, depth only: " << static_cast<float>(stats.depthOnlyRasterNs) / stats.rasterTimedTriangles
+				<< ", color: " << static_cast<float>(stats.colorRasterNs) / stats.rasterTimedTriangles;
+		}
+		return os;
+	}
+}
@@ -1,14 +1,198 @@
 //External includes
 #include "SDL.h"
 #include "SDL_surface.h"
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <emmintrin.h>
 
 //Project includes
 #include "Renderer.h"
+#include "MeshletBuilder.h"
+#include "SampleBuffer.h"
+#include "Scene.h"
+#include "SwapChain.h"
+#include "TiledFramebuffer.h"
 #include "Texture.h"
 #include "Utils.h"
+#include "VertexPacking.h"
 
 using namespace dae;
 
+namespace
+{
+	// Cross(to - from, pixel - from) / area written as a * x + b * y + c, so it steps linearly across the screen
+	struct EdgeFunction
+	{
+		float a{};
+		float b{};
+		float c{};
+
+		static EdgeFunction Create(const Vector2& from, const Vector2& to, float invAreaTrig)
+		{
+			const Vector2 edge{ to - from };
+			return { -edge.y * invAreaTrig, edge.x * invAreaTrig, (edge.y * from.x - edge.x * from.y) * invAreaTrig };
+		}
+
+		// Smallest and largest value over the rectangle [min, max]
+		float GetMin(const Vector2& min, const Vector2& max) const
+		{
+			return a * (a >= 0.f ? min.x : max.x) + b * (b >= 0.f ? min.y : max.y) + c;
+		}
+		float GetMax(const Vector2& min, const Vector2& max) const
+		{
+			return a * (a >= 0.f ? max.x : min.x) + b * (b >= 0.f ? max.y : min.y) + c;
+		}
+	};
+
+	// Calls function(idx0, idx1, idx2) for every triangle, strips come out with their winding already fixed
+	template<typename TriangleFunction>
+	void ForEachTriangle(std::span<const uint32_t> indices, PrimitiveTopology topology, TriangleFunction function)
+	{
+		const int nrIndices{ static_cast<int>(indices.size()) };
+
+		switch (topology)
+		{
+		case PrimitiveTopology::TriangleList:
+			for (int idx{}; idx + 2 < nrIndices; idx += 3)
+				function(indices[idx], indices[idx + 1], indices[idx + 2]);
+			break;
+		case PrimitiveTopology::TriangleStrip:
+			for (int idx{}; idx + 2 < nrIndices; ++idx)
+			{
+				// Degenerate triangles only restart the strip
+				const uint32_t idx0{ indices[idx] };
+				const uint32_t idx1{ indices[idx + 1] };
+				const uint32_t idx2{ indices[idx + 2] };
+				if (idx0 == idx1 || idx1 == idx2 || idx0 == idx2)
+					continue;
+
+				// Every odd triangle in a strip has its winding flipped
+				if (idx % 2 == 0)
+					function(idx0, idx1, idx2);
+				else
+					function(idx0, idx2, idx1);
+			}
+			break;
+		}
+	}
+
+	// Pixels whose center lies inside the triangle's bounds grown by sampleExtent.
+	// Clamped to clip before converting, so far away vertices can't overflow
+	TileRect GetPixelBounds(const Vector2& p0, const Vector2& p1, const Vector2& p2, float sampleExtent, const TileRect& clip)
+	{
+		const auto getFirstCenter = [sampleExtent](float min, int clipMin, int clipMax)
+		{
+			return static_cast<int>(std::ceil(std::clamp(min - 0.5f - sampleExtent, static_cast<float>(clipMin), static_cast<float>(clipMax))));
+		};
+		const auto getEndCenter = [sampleExtent](float max, int clipMin, int clipMax)
+		{
+			return static_cast<int>(std::floor(std::clamp(max - 0.5f + sampleExtent, clipMin - 1.f, clipMax - 1.f))) + 1;
+		};
+
+		return {
+			getFirstCenter(std::min({ p0.x, p1.x, p2.x }), clip.minX, clip.maxX),
+			getFirstCenter(std::min({ p0.y, p1.y, p2.y }), clip.minY, clip.maxY),
+			getEndCenter(std::max({ p0.x, p1.x, p2.x }), clip.minX, clip.maxX),
+			getEndCenter(std::max({ p0.y, p1.y, p2.y }), clip.minY, clip.maxY)
+		};
+	}
+
+	constexpr uint32_t EMPTY_VISIBILITY_ID{ UINT32_MAX };
+
+	// Pixels of one triangle collected until the SSE shader can do 4 of them at once
+	struct PendingPixels
+	{
+		alignas(16) float weights0[4]{};
+		alignas(16) float weights1[4]{};
+		alignas(16) float weights2[4]{};
+		size_t pixelIdx[4]{};
+		int x[4]{};
+		int y[4]{};
+		uint32_t sampleMask[4]{};
+		int count{};
+
+		// True once all 4 lanes are taken
+		bool Add(size_t idx, int px, int py, float weight0, float weight1, float weight2, uint32_t mask)
+		{
+			weights0[count] = weight0;
+			weights1[count] = weight1;
+			weights2[count] = weight2;
+			pixelIdx[count] = idx;
+			x[count] = px;
+			y[count] = py;
+			sampleMask[count] = mask;
+			return ++count == 4;
+		}
+
+		// Calls shadeQuad(weights0, weights1, weights2) once, then write(lane, color) for every pending pixel, and empties the quad
+		template<typename ShadeQuadFunction, typename WriteFunction>
+		void Shade(ShadeQuadFunction shadeQuad, WriteFunction write)
+		{
+			// Unused lanes repeat the first pixel, so they shade something valid that never gets written
+			for (int lane{ count }; lane < 4; ++lane)
+			{
+				weights0[lane] = weights0[0];
+				weights1[lane] = weights1[0];
+				weights2[lane] = weights2[0];
+			}
+
+			const ColorQuad colors{ shadeQuad(_mm_load_ps(weights0), _mm_load_ps(weights1), _mm_load_ps(weights2)) };
+			alignas(16) float r[4];
+			alignas(16) float g[4];
+			alignas(16) float b[4];
+			_mm_store_ps(r, colors.r);
+			_mm_store_ps(g, colors.g);
+			_mm_store_ps(b, colors.b);
+
+			for (int lane{}; lane < count; ++lane)
+				write(lane, ColorRGB{ r[lane], g[lane], b[lane] });
+			count = 0;
+		}
+	};
+
+	size_t GetNrVertices(const Mesh& mesh)
+	{
+		return mesh.GetVertices().empty() ? mesh.packedVertices.size() : mesh.GetVertices().size();
+	}
+
+	// Calls function(idx, position) for every vertex of the mesh, packed vertices get decoded in batches like the color pass does
+	template<typename PositionFunction>
+	void ForEachVertexPosition(const Mesh& mesh, PositionFunction function)
+	{
+		const std::span<const Vertex> vertices{ mesh.GetVertices() };
+		if (!vertices.empty())
+		{
+			for (size_t idx{}; idx < vertices.size(); ++idx)
+				function(idx, vertices[idx].position);
+			return;
+		}
+
+		constexpr size_t batchSize{ 64 };
+		std::array<Vertex, batchSize> decodedBatch{};
+
+		const size_t nrVertices{ mesh.packedVertices.size() };
+		for (size_t batchStart{}; batchStart < nrVertices; batchStart += batchSize)
+		{
+			const size_t nrBatchVertices{ std::min(batchSize, nrVertices - batchStart) };
+			VertexPacking::Decode(mesh.packedVertices.data() + batchStart, nrBatchVertices, mesh.quantization, decodedBatch.data());
+
+			for (size_t idx{}; idx < nrBatchVertices; ++idx)
+				function(batchStart + idx, decodedBatch[idx].position);
+		}
+	}
+
+	bool IsRenderedAsMeshlets(const Mesh& mesh)
+	{
+		return mesh.primitiveTopology == PrimitiveTopology::TriangleList && !mesh.GetMeshlets().empty();
+	}
+
+	uint64_t GetNsSince(std::chrono::steady_clock::time_point start)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
 Renderer::Renderer(SDL_Window* pWindow) :
 	m_pWindow(pWindow)
 {
@@ -16,26 +200,39 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 
 	//Create Buffers
-	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
-
-	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_pSwapChain = new SwapChain(pWindow, MAX_FRAMES_IN_FLIGHT);
+	for (uint32_t frameIdx{}; frameIdx < MAX_FRAMES_IN_FLIGHT; ++frameIdx)
+	{
+		Frame& frame{ m_Frames[frameIdx] };
+		frame.pColorBuffer = m_pSwapChain->GetBuffer(frameIdx);
+		frame.pColorBufferPixels = (uint32_t*)frame.pColorBuffer->pixels;
+		for (DrawBatch& batch : frame.batches)
+			batch.bins.Resize(m_Width, m_Height);
+	}
+	m_TileStats.resize(m_Frames[0].batches[0].bins.GetNrTiles());
+	m_TileLights.resize(m_TileStats.size());
 
-	const int nrTrigVertices{ 3 };
+	m_pFramebuffer = new TiledFramebuffer(m_Width, m_Height);
+	m_pSampleBuffer = new SampleBuffer(m_Width, m_Height);
+	m_pSampleBuffer->SetSampleCount(m_Settings.msaaSampleCount);
+	m_VisibilityBuffer.resize(m_pFramebuffer->GetNrPixels(), EMPTY_VISIBILITY_ID);
 
 	m_AspectRatio = static_cast<float>(m_Width) / m_Height;
-	m_TrigVertexVec.resize(nrTrigVertices);
-	m_AreaParallelVec.resize(nrTrigVertices);
 
 	//Initialize Camera
-	m_Camera.Initialize(60.f, { .0f,.0f,-10.f });
+	m_Camera.Initialize(45.f, { .0f, 5.f, -64.f });
 
 }
 
 Renderer::~Renderer()
 {
-	delete[] m_pDepthBufferPixels;
+	// The raster jobs still use the buffers
+	for (Frame& frame : m_Frames)
+		JobSystem::GetInstance().Wait(frame.rasterCounter);
+
+	delete m_pSwapChain;
+	delete m_pFramebuffer;
+	delete m_pSampleBuffer;
 }
 
 void Renderer::Update(Timer* pTimer)
@@ -43,169 +240,1351 @@ void Renderer::Update(Timer* pTimer)
 	m_Camera.Update(pTimer);
 }
 
-void Renderer::Render()
+void Renderer::Render(const Scene& scene)
+{
+	// Whatever used this slot before has been handed to the swap chain already, but may not be on the window yet
+	const uint32_t frameIdx{ m_NrFramesBuilt % MAX_FRAMES_IN_FLIGHT };
+	Frame& frame{ m_Frames[frameIdx] };
+	Frame& previousFrame{ m_Frames[(m_NrFramesBuilt + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT] };
+	if (m_pSwapChain->IsQueued(frameIdx))
+		m_pSwapChain->ShowQueued();
+	BuildFrame(scene, frame);
+
+	// Frames share the depth and sample buffers, so rasterization waits for the frame before
+	JobSystem::GetInstance().Run(frame.rasterCounter, [this, &frame]() { RasterizeFrame(frame); }, previousFrame.rasterCounter);
+	++m_NrFramesBuilt;
+	++m_NrFramesInFlight;
+
+	// The frames presented before get copied to the window while this one rasterizes
+	m_pSwapChain->ShowQueued();
+
+	while (m_NrFramesInFlight > m_Settings.frameLatency)
+		PresentFrame();
+}
+
+void Renderer::Flush()
+{
+	while (m_NrFramesInFlight > 0)
+		PresentFrame();
+	m_pSwapChain->ShowQueued();
+}
+
+void Renderer::BuildFrame(const Scene& scene, Frame& frame)
 {
 	//@START
 	//Lock BackBuffer
-	SDL_LockSurface(m_pBackBuffer);
+	SDL_LockSurface(frame.pColorBuffer);
+
+	frame.settings = m_Settings;
+	frame.stats = {};
+	const std::vector<MeshInstance>& instances{ scene.GetInstances() };
+	frame.stats.instancesTotal = static_cast<uint32_t>(instances.size());
+
+	// Skip whole instances before any of their vertices get transformed
+	const Frustum frustum{ m_Camera.GetFrustum(m_AspectRatio) };
+	BVHCullStats cullStats{};
+	m_VisibleInstances.clear();
+	scene.GetBVH().CullFrustum(frustum, m_VisibleInstances, cullStats);
+	frame.stats.bvhNodesVisited = cullStats.nodesVisited;
+	frame.stats.bvhNodesCulled = cullStats.nodesCulled;
+
+	SelectLods(scene);
+
+	// Before the rest of the frame gets reset, the occlusion history can be this slot's previous frame
+	if (m_Settings.isOcclusionCullingEnabled)
+		CullOccludedInstances(scene, frame);
+	frame.stats.instancesDrawn = static_cast<uint32_t>(m_VisibleInstances.size());
+
+	frame.worldToCamera = m_Camera.worldToCamera;
+
+	const DirectionalLight& light{ scene.GetDirectionalLight() };
+	frame.shading.lightDirection = m_Camera.worldToCamera.TransformVector(light.direction).Normalized();
+	frame.shading.lightColor = light.color * light.intensity;
+	frame.shading.ambientColor = scene.GetAmbientColor();
+	CullPointLights(scene, frame);
+
+	frame.shading.pShadowMap = nullptr;
+	if (IsShadowMapUsed())
+		RenderShadowMap(scene, frame);
+
+	QueueDraws(scene);
+
+	// Batch sizes only change the work split, the tiles end up with the same triangles in the same order
+	JobSystem& jobSystem{ JobSystem::GetInstance() };
+	const uint32_t nrDraws{ static_cast<uint32_t>(m_DrawQueue.GetSize()) };
+	const uint32_t maxBatches{ std::min(jobSystem.GetNrThreads() * DRAW_BATCHES_PER_THREAD, MAX_DRAW_BATCHES) };
+	const uint32_t drawsPerBatch{ std::max((nrDraws + maxBatches - 1) / maxBatches, 1u) };
+	frame.nrBatches = (nrDraws + drawsPerBatch - 1) / drawsPerBatch;
+
+	jobSystem.ParallelFor(frame.nrBatches, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t batchIdx{ begin }; batchIdx < end; ++batchIdx)
+		{
+			DrawBatch& batch{ frame.batches[batchIdx] };
+			batch.nrVertices = 0;
+			batch.triangles.clear();
+			batch.bins.Clear();
+			batch.stats = {};
+
+			const uint32_t lastDraw{ std::min((batchIdx + 1) * drawsPerBatch, nrDraws) };
+			for (uint32_t drawIdx{ batchIdx * drawsPerBatch }; drawIdx < lastDraw; ++drawIdx)
+			{
+				const uint32_t instanceIdx{ m_DrawQueue[drawIdx] };
+				++batch.stats.instancesPerLod[m_InstanceLods[instanceIdx]];
+				RenderInstance(batch, instances[instanceIdx], m_InstanceLods[instanceIdx], frustum);
+			}
+		}
+	});
+
+	for (uint32_t batchIdx{}; batchIdx < frame.nrBatches; ++batchIdx)
+	{
+		const RenderStats& batchStats{ frame.batches[batchIdx].stats };
+		for (size_t lodIdx{}; lodIdx < batchStats.instancesPerLod.size(); ++lodIdx)
+			frame.stats.instancesPerLod[lodIdx] += batchStats.instancesPerLod[lodIdx];
+		frame.stats.meshletsTotal += batchStats.meshletsTotal;
+		frame.stats.meshletsFrustumCulled += batchStats.meshletsFrustumCulled;
+		frame.stats.meshletsConeCulled += batchStats.meshletsConeCulled;
+		frame.stats.trianglesWithoutCoverage += batchStats.trianglesWithoutCoverage;
+	}
+}
+
+void Renderer::RasterizeFrame(Frame& frame)
+{
+	if (m_pSampleBuffer->GetSampleCount() > 1)
+		m_pSampleBuffer->Clear(m_ClearColor);
+
+	// Tiles never share a pixel, and every tile draws its triangles in submission order
+	JobSystem::GetInstance().ParallelFor(static_cast<uint32_t>(m_TileStats.size()), 1, [this, &frame](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t tileIdx{ begin }; tileIdx < end; ++tileIdx)
+		{
+			m_TileStats[tileIdx] = {};
+			RasterizeTile(frame, tileIdx, m_TileStats[tileIdx]);
+		}
+	});
+
+	for (const RenderStats& tileStats : m_TileStats)
+	{
+		frame.stats.trianglesSmall += tileStats.trianglesSmall;
+		frame.stats.blocksAccepted += tileStats.blocksAccepted;
+		frame.stats.blocksPartial += tileStats.blocksPartial;
+		frame.stats.blocksRejected += tileStats.blocksRejected;
+		frame.stats.pixelsShaded += tileStats.pixelsShaded;
+		frame.stats.pixelsCovered += tileStats.pixelsCovered;
+		frame.stats.tileLights += tileStats.tileLights;
+		frame.stats.rasterTimedTriangles += tileStats.rasterTimedTriangles;
+		frame.stats.depthOnlyRasterNs += tileStats.depthOnlyRasterNs;
+		frame.stats.colorRasterNs += tileStats.colorRasterNs;
+	}
+	frame.stats.tiles = static_cast<uint32_t>(m_TileStats.size());
+
+	// Whatever ended up in the depth buffer can occlude later frames
+	frame.hasOcclusionHistory = frame.settings.isOcclusionCullingEnabled && frame.settings.isTemporalOcclusionEnabled;
+	if (frame.hasOcclusionHistory)
+		frame.occlusionHistory.DownsampleFrom(*m_pFramebuffer);
+}
+
+void Renderer::RasterizeTile(const Frame& frame, uint32_t tileIdx, RenderStats& stats)
+{
+	const TileRect tile{ frame.batches[0].bins.GetTileRect(tileIdx) };
+	ClearTile(frame, tile);
+
+	const bool isMultisampled{ m_pSampleBuffer->GetSampleCount() > 1 };
+	const bool isRasterTimed{ IsRasterTimed(frame) };
+
+	// Forward shading happens during rasterization, before the depth is known. The depth range of every triangle binned here
+	// is free and always covers it, a depth only pre-pass finds the exact one when that still leaves many lights
+	std::vector<ShadingPointLight>& lights{ m_TileLights[tileIdx] };
+	if (!frame.settings.isVisibilityBufferEnabled)
+	{
+		DepthRange binnedDepth{};
+		for (uint32_t batchIdx{}; batchIdx < frame.nrBatches; ++batchIdx)
+			binnedDepth.Add(frame.batches[batchIdx].bins.GetDepthRange(tileIdx));
+		CullTileLights(frame, tile, binnedDepth, lights);
+
+		// The pre-pass is single sampled, MSAA keeps the binned range
+		const bool isPrepassWorthIt{ IsTileDepthCulled(frame) && lights.size() > MIN_DEPTH_PREPASS_LIGHTS };
+		if (!isMultisampled && (isPrepassWorthIt || isRasterTimed))
+		{
+			RasterizeTileDepth(frame, tileIdx, tile, stats);
+			CullTileLights(frame, tile, GetTileDepthRange(tile), lights);
+		}
+	}
+
+	// Walking the batches in order merges their bins back into draw order
+	const auto rasterStart{ isRasterTimed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{} };
+	for (uint32_t batchIdx{}; batchIdx < frame.nrBatches; ++batchIdx)
+	{
+		const DrawBatch& batch{ frame.batches[batchIdx] };
+		for (const uint32_t triangleIdx : batch.bins.GetTriangles(tileIdx))
+		{
+			const RasterizeFunction rasterize{ GetRasterizeFunction(batch.triangles[triangleIdx].pixelPipelineIdx) };
+			(this->*rasterize)(frame, batchIdx, triangleIdx, tile, lights, stats);
+		}
+		if (isRasterTimed)
+			stats.rasterTimedTriangles += static_cast<uint32_t>(batch.bins.GetTriangles(tileIdx).size());
+	}
+	if (isRasterTimed)
+		stats.colorRasterNs += GetNsSince(rasterStart);
 
-	UpdateBuffer();
+	if (frame.settings.isVisibilityBufferEnabled)
+	{
+		// The depth is final here, so only the visible surfaces count
+		CullTileLights(frame, tile, GetTileDepthRange(tile), lights);
+		ShadeVisibilityTile(frame, tile, lights, stats);
+	}
+	stats.tileLights += static_cast<uint32_t>(lights.size());
+
+	if (m_pSampleBuffer->GetSampleCount() > 1)
+		ResolveTile(tile);
+
+	// Tile rows follow each other, the part past the screen edge is skipped
+	const float* pDepthRow{ m_pFramebuffer->GetDepth() + m_pFramebuffer->GetPixelIdx(tile.minX, tile.minY) };
+	for (int py{ tile.minY }; py < tile.maxY; ++py, pDepthRow += TiledFramebuffer::TILE_SIZE)
+		for (int px{}; px < tile.maxX - tile.minX; ++px)
+			stats.pixelsCovered += pDepthRow[px] != std::numeric_limits<float>::max();
+
+	// Copied while the tile is still in cache
+	m_pFramebuffer->DetileColors(tile, frame.pColorBufferPixels, frame.pColorBuffer->pitch / static_cast<int>(sizeof(uint32_t)));
+}
+
+void Renderer::CullPointLights(const Scene& scene, Frame& frame)
+{
+	frame.pointLights.clear();
+	frame.pointLightBounds.clear();
+	const std::vector<PointLight>& lights{ scene.GetPointLights() };
+	frame.stats.pointLightsTotal = static_cast<uint32_t>(lights.size());
 
-	// Setup vertices for screen space
-	std::vector<Vertex> vertices_world
+	const float nearPlane{ m_Camera.nearPlane };
+	const float fovX{ m_Camera.fov * m_AspectRatio };
+	for (const PointLight& light : lights)
 	{
-		// Triangle 1
-		{{0.f, 2.f, 0.f}, {1, 0, 0}},
-		{{1.5f, -1.f, 0.f}, {1, 0, 0}},
-		{{-1.5f, -1.f, 0.f}, {1, 0 ,0}},
-		// Triangle 2
-		{{0.f, 4.f, 2.f}, {1, 0, 0}},
-		{{3.f, -2.f, 2.f}, {0, 1, 0}},
-		{{-3.f, -2.f, 2.f}, {0, 0 ,1}}
+		const Vector3 center{ m_Camera.worldToCamera.TransformPoint(light.position) };
+		const float nearDepth{ center.z - light.radius };
+		const float farDepth{ center.z + light.radius };
+		if (farDepth <= nearPlane)
+			continue;
+
+		// A sphere reaching past the near plane can project anywhere, so it keeps the whole screen
+		PointLightBounds bounds{ 0.f, 0.f, static_cast<float>(m_Width), static_cast<float>(m_Height) };
+		if (nearDepth > nearPlane)
+		{
+			// x / z over the sphere's bounding box is smallest and largest at its corners
+			const auto getMin = [&](float min) { return min / (min >= 0.f ? farDepth : nearDepth); };
+			const auto getMax = [&](float max) { return max / (max >= 0.f ? nearDepth : farDepth); };
+			bounds.minX = (getMin(center.x - light.radius) / fovX + 1) * 0.5f * m_Width;
+			bounds.maxX = (getMax(center.x + light.radius) / fovX + 1) * 0.5f * m_Width;
+			bounds.minY = (1 - getMax(center.y + light.radius) / m_Camera.fov) * 0.5f * m_Height;
+			bounds.maxY = (1 - getMin(center.y - light.radius) / m_Camera.fov) * 0.5f * m_Height;
+
+			if (bounds.maxX <= 0.f || bounds.minX >= m_Width || bounds.maxY <= 0.f || bounds.minY >= m_Height)
+				continue;
+		}
+		bounds.depth = { ProjectToScreen({ 0.f, 0.f, std::max(nearDepth, nearPlane) }).z, ProjectToScreen({ 0.f, 0.f, farDepth }).z };
+
+		frame.pointLights.push_back({ center, 1.f / (light.radius * light.radius), light.color * light.intensity });
+		frame.pointLightBounds.push_back(bounds);
+	}
+	frame.stats.pointLightsOnScreen = static_cast<uint32_t>(frame.pointLights.size());
+}
+
+void Renderer::CullTileLights(const Frame& frame, const TileRect& tile, const DepthRange& depth, std::vector<ShadingPointLight>& lights)
+{
+	lights.clear();
+
+	// Only the lit modes that add up light sources use them
+	const ShadingMode mode{ frame.settings.shadingMode };
+	if (mode == ShadingMode::Unlit || mode == ShadingMode::ObservedArea)
+		return;
+
+	if (!frame.settings.isLightCullingEnabled)
+	{
+		lights = frame.pointLights;
+		return;
+	}
+
+	for (size_t lightIdx{}; lightIdx < frame.pointLights.size(); ++lightIdx)
+	{
+		const PointLightBounds& bounds{ frame.pointLightBounds[lightIdx] };
+		const bool isOverlappingTile{ bounds.minX < tile.maxX && bounds.maxX > tile.minX && bounds.minY < tile.maxY && bounds.maxY > tile.minY };
+		// An empty depth range overlaps nothing
+		const bool isOverlappingDepth{ bounds.depth.min <= depth.max && bounds.depth.max >= depth.min };
+		if (isOverlappingTile && isOverlappingDepth)
+			lights.push_back(frame.pointLights[lightIdx]);
+	}
+}
+
+bool Renderer::IsRasterTimed(const Frame& frame) const
+{
+	return frame.settings.isRasterTimingEnabled && !frame.settings.isVisibilityBufferEnabled && m_pSampleBuffer->GetSampleCount() == 1;
+}
+
+bool Renderer::IsTileDepthCulled(const Frame& frame)
+{
+	const ShadingMode mode{ frame.settings.shadingMode };
+	const bool isLit{ mode != ShadingMode::Unlit && mode != ShadingMode::ObservedArea };
+	return isLit && frame.settings.isLightCullingEnabled && !frame.pointLights.empty();
+}
+
+void Renderer::RasterizeTileDepth(const Frame& frame, uint32_t tileIdx, const TileRect& tile, RenderStats& stats)
+{
+	// The color pass counts the same triangles and blocks
+	RenderStats depthStats{};
+
+	const bool isRasterTimed{ IsRasterTimed(frame) };
+	const auto rasterStart{ isRasterTimed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{} };
+	for (uint32_t batchIdx{}; batchIdx < frame.nrBatches; ++batchIdx)
+	{
+		for (const uint32_t triangleIdx : frame.batches[batchIdx].bins.GetTriangles(tileIdx))
+			RasterizeTriangle<RasterMode::DepthOnly, ShaderConfig{}>(frame, batchIdx, triangleIdx, tile, {}, depthStats);
+	}
+	if (isRasterTimed)
+		stats.depthOnlyRasterNs += GetNsSince(rasterStart);
+}
+
+DepthRange Renderer::GetTileDepthRange(const TileRect& tile) const
+{
+	DepthRange depth{};
+	const float* pDepthRow{ m_pFramebuffer->GetDepth() + m_pFramebuffer->GetPixelIdx(tile.minX, tile.minY) };
+	for (int py{ tile.minY }; py < tile.maxY; ++py, pDepthRow += TiledFramebuffer::TILE_SIZE)
+	{
+		for (int px{}; px < tile.maxX - tile.minX; ++px)
+		{
+			if (pDepthRow[px] != std::numeric_limits<float>::max())
+				depth.Add({ pDepthRow[px], pDepthRow[px] });
+		}
+	}
+	return depth;
+}
+
+bool Renderer::IsShadowMapUsed() const
+{
+	const ShadingMode mode{ m_Settings.shadingMode };
+	return m_Settings.isShadowMapEnabled && (mode == ShadingMode::Diffuse || mode == ShadingMode::Specular || mode == ShadingMode::Combined);
+}
+
+void Renderer::RenderShadowMap(const Scene& scene, Frame& frame)
+{
+	const std::vector<MeshInstance>& instances{ scene.GetInstances() };
+	const BVH& bvh{ scene.GetBVH() };
+	if (!frame.pShadowMap)
+		frame.pShadowMap = std::make_unique<DepthBuffer>(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+	DepthBuffer& shadowMap{ *frame.pShadowMap };
+	shadowMap.Clear();
+	frame.shading.pShadowMap = &shadowMap;
+	frame.stats.shadowCasters = static_cast<uint32_t>(instances.size());
+	if (instances.empty())
+		return;
+
+	// Light space looks along the light, with the same axes as the camera's view space
+	const Vector3 forward{ scene.GetDirectionalLight().direction.Normalized() };
+	const Vector3 right{ Vector3::Cross(std::abs(forward.y) < 0.99f ? Vector3::UnitY : Vector3::UnitZ, forward).Normalized() };
+	const Vector3 up{ Vector3::Cross(forward, right) };
+	const Matrix worldToLight{ Matrix::CreateLookAtLH({}, forward, up, right) };
+
+	// Every instance can cast a shadow on screen, so the orthographic projection is fitted around all of them
+	AABB lightBounds{};
+	for (uint32_t instanceIdx{}; instanceIdx < instances.size(); ++instanceIdx)
+	{
+		const AABB& bounds{ bvh.GetPrimitiveBounds(instanceIdx) };
+		for (int corner{}; corner < 8; ++corner)
+		{
+			lightBounds.Grow(worldToLight.TransformPoint(corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y,
+				corner & 4 ? bounds.max.z : bounds.min.z));
+		}
+	}
+	// A margin keeps the outermost vertices inside the depth range after rounding
+	const Vector3 margin{ (lightBounds.max - lightBounds.min) * 0.01f + Vector3{ 0.01f, 0.01f, 0.01f } };
+	lightBounds.min -= margin;
+	lightBounds.max += margin;
+
+	// Light space to shadow map pixels like ProjectToScreen without the perspective divide, depth goes from 0 to 1 across the bounds
+	const int size{ shadowMap.GetWidth() };
+	const Vector3 extent{ lightBounds.max - lightBounds.min };
+	const float scaleX{ size / extent.x };
+	const float scaleY{ size / extent.y };
+	const float scaleZ{ 1.f / extent.z };
+	const Matrix lightToShadow{
+		Vector4{ scaleX, 0.f, 0.f, 0.f },
+		Vector4{ 0.f, -scaleY, 0.f, 0.f },
+		Vector4{ 0.f, 0.f, scaleZ, 0.f },
+		Vector4{ -lightBounds.min.x * scaleX, lightBounds.max.y * scaleY, -lightBounds.min.z * scaleZ, 1.f }
 	};
-	std::vector<Vertex> screenSpaceVec{};
-	screenSpaceVec.resize(vertices_world.size());
-	VertexTransformationFunction(vertices_world, screenSpaceVec);
+	const Matrix worldToShadow{ worldToLight * lightToShadow };
 
-	const int nrTrigVertices{ 3 };
-	const int nrTrigs{ static_cast<int>(vertices_world.size()) / nrTrigVertices };
+	// Lookups move 1.5 shadow map pixels along the normal and one pixel's worth of depth towards the light
+	const float pixelSize{ std::max(extent.x, extent.y) / size };
+	frame.shading.viewToShadow = Matrix::Inverse(frame.worldToCamera) * worldToShadow;
+	frame.shading.shadowNormalOffset = 1.5f * pixelSize;
+	frame.shading.shadowDepthBias = pixelSize * scaleZ;
 
-	for (int trigIdx{}; trigIdx < nrTrigs; ++trigIdx)
+	// The coarsest LOD whose error stays below a shadow map pixel
+	const uint32_t nrBands{ static_cast<uint32_t>((shadowMap.GetHeight() + SHADOW_BAND_HEIGHT - 1) / SHADOW_BAND_HEIGHT) };
+	m_ShadowCasters.resize(instances.size());
+	uint32_t nrVertices{};
+	for (uint32_t instanceIdx{}; instanceIdx < instances.size(); ++instanceIdx)
 	{
-		// Fill up the current triangle
-		for (int vertexIdx{}; vertexIdx < nrTrigVertices; ++vertexIdx)
-			m_TrigVertexVec[vertexIdx] = screenSpaceVec[trigIdx * nrTrigVertices + vertexIdx].position;
+		const MeshInstance& instance{ instances[instanceIdx] };
+		const Mesh& mesh{ *instance.pMesh };
+		const std::span<const MeshLod> lods{ mesh.GetLods() };
+		const Matrix& worldMatrix{ instance.worldMatrix };
+		const float maxScale{ std::max({ worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude(), worldMatrix.GetAxisZ().Magnitude() }) };
+
+		ShadowCaster& caster{ m_ShadowCasters[instanceIdx] };
+		caster.firstVertex = nrVertices;
+		caster.lodIdx = 0;
+		while (m_Settings.isLodEnabled && caster.lodIdx + 1u < lods.size() && lods[caster.lodIdx + 1].error * maxScale < pixelSize)
+			++caster.lodIdx;
+		caster.bands.resize(nrBands);
+		nrVertices += static_cast<uint32_t>(GetNrVertices(mesh));
+	}
+	m_ShadowVertices.resize(nrVertices);
 
-		// Calculate area of triangle
-		const Vector2 edge1{ m_TrigVertexVec[1] - m_TrigVertexVec[0] };
-		const Vector2 edge2{ m_TrigVertexVec[2] - m_TrigVertexVec[0] };
-		const float areaTrig{ Vector2::Cross(edge1, edge2) / 2 };
+	// Every caster gets transformed and binned to the bands of rows its front facing triangles touch on its own
+	JobSystem& jobSystem{ JobSystem::GetInstance() };
+	jobSystem.ParallelFor(static_cast<uint32_t>(instances.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t instanceIdx{ begin }; instanceIdx < end; ++instanceIdx)
+		{
+			ShadowCaster& caster{ m_ShadowCasters[instanceIdx] };
+			const MeshInstance& instance{ instances[instanceIdx] };
+			const Mesh& mesh{ *instance.pMesh };
+			const Matrix worldShadowMatrix{ instance.worldMatrix * worldToShadow };
+			Vector4* pVertices{ m_ShadowVertices.data() + caster.firstVertex };
+			ForEachVertexPosition(mesh, [&](size_t idx, const Vector3& position)
+			{
+				const Vector3 projected{ worldShadowMatrix.TransformPoint(position) };
+				pVertices[idx] = { projected.x, projected.y, projected.z, 1.f };
+			});
 
-		const Rect boundingBox{ GetBoundingBox(m_TrigVertexVec) };
+			for (std::vector<std::array<uint32_t, 3>>& band : caster.bands)
+				band.clear();
+			ForEachTriangle(mesh.GetLodIndices(caster.lodIdx), mesh.primitiveTopology, [&](uint32_t idx0, uint32_t idx1, uint32_t idx2)
+			{
+				const Vector4& v0{ pVertices[idx0] };
+				const Vector4& v1{ pVertices[idx1] };
+				const Vector4& v2{ pVertices[idx2] };
+				if (Vector2::Cross({ v1.x - v0.x, v1.y - v0.y }, { v2.x - v0.x, v2.y - v0.y }) <= 0.f)
+					return;
 
-		// Clamp bounding box to not be any negative values (out of screen)
-		const int startX{ std::clamp(boundingBox.x, 0, m_Width) };
-		const int startY{ std::clamp(boundingBox.y, 0, m_Height) };
-		const int endX{ std::clamp(boundingBox.x + boundingBox.width, 0, m_Width) };
-		const int endY{ std::clamp(boundingBox.y + boundingBox.height, 0, m_Height) };
+				const float lastBand{ static_cast<float>(nrBands - 1) };
+				const int firstBand{ static_cast<int>(std::clamp(std::min({ v0.y, v1.y, v2.y }) / SHADOW_BAND_HEIGHT, 0.f, lastBand)) };
+				const int endBand{ static_cast<int>(std::clamp(std::max({ v0.y, v1.y, v2.y }) / SHADOW_BAND_HEIGHT, 0.f, lastBand)) + 1 };
+				for (int bandIdx{ firstBand }; bandIdx < endBand; ++bandIdx)
+					caster.bands[bandIdx].push_back({ idx0, idx1, idx2 });
+			});
+		}
+	});
 
-		for (int px{ startX }; px < endX; ++px)
+	// Depth only keeps the closest value, so the order of the casters doesn't matter
+	jobSystem.ParallelFor(nrBands, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t bandIdx{ begin }; bandIdx < end; ++bandIdx)
 		{
-			const float screenX{ px + 0.5f };
+			const int firstRow{ static_cast<int>(bandIdx) * SHADOW_BAND_HEIGHT };
+			for (const ShadowCaster& caster : m_ShadowCasters)
+			{
+				const Vector4* pVertices{ m_ShadowVertices.data() + caster.firstVertex };
+				for (const std::array<uint32_t, 3>& triangle : caster.bands[bandIdx])
+					shadowMap.RasterizeTriangle(pVertices[triangle[0]], pVertices[triangle[1]], pVertices[triangle[2]], firstRow, firstRow + SHADOW_BAND_HEIGHT);
+			}
+		}
+	});
+}
+
+void Renderer::PresentFrame()
+{
+	const uint32_t frameIdx{ (m_NrFramesBuilt - m_NrFramesInFlight) % MAX_FRAMES_IN_FLIGHT };
+	Frame& frame{ m_Frames[frameIdx] };
+	JobSystem::GetInstance().Wait(frame.rasterCounter);
+	--m_NrFramesInFlight;
+
+	m_Stats = frame.stats;
+	m_pPresentedFrame = &frame;
+
+	//@END
+	//Update SDL Surface, the copy to the window happens in the next Render or Flush
+	SDL_UnlockSurface(frame.pColorBuffer);
+	m_pSwapChain->Present(frameIdx);
+}
+
+void Renderer::SetSettings(const RenderSettings& settings)
+{
+	// The frames in flight were binned with the old settings
+	Flush();
+
+	// A history from before the toggle would be stale by the time it gets used again
+	if (!settings.isOcclusionCullingEnabled || !settings.isTemporalOcclusionEnabled)
+	{
+		for (Frame& frame : m_Frames)
+			frame.hasOcclusionHistory = false;
+	}
+
+	m_Settings = settings;
+
+	m_Settings.frameLatency = std::min(settings.frameLatency, RenderSettings::MAX_FRAME_LATENCY);
+	m_Settings.msaaSampleCount = std::bit_floor(std::clamp(settings.msaaSampleCount, 1u, SampleBuffer::MAX_SAMPLES));
+
+	// The visibility buffer holds one triangle per pixel, so it renders without MSAA
+	const uint32_t sampleCount{ m_Settings.isVisibilityBufferEnabled ? 1u : m_Settings.msaaSampleCount };
+	if (sampleCount != m_pSampleBuffer->GetSampleCount())
+		m_pSampleBuffer->SetSampleCount(sampleCount);
+}
+
+void Renderer::ClearTile(const Frame& frame, const TileRect& tile)
+{
+	m_pFramebuffer->ClearTile(tile, GetSDLRGB(m_ClearColor), std::numeric_limits<float>::max());
+
+	if (frame.settings.isVisibilityBufferEnabled)
+	{
+		const size_t firstPixel{ m_pFramebuffer->GetPixelIdx(tile.minX, tile.minY) };
+		std::fill_n(m_VisibilityBuffer.begin() + firstPixel, TiledFramebuffer::TILE_PIXELS, EMPTY_VISIBILITY_ID);
+	}
+}
+
+void Renderer::ResolveTile(const TileRect& tile)
+{
+	// Sample buffer tile by sample buffer tile, so the samples are read in memory order
+	constexpr int blockSize{ SampleBuffer::TILE_SIZE };
+	static_assert(TiledFramebuffer::TILE_SIZE % blockSize == 0);
+	float* pDepth{ m_pFramebuffer->GetDepth() };
 
-			for (int py{ startY }; py < endY; ++py)
+	for (int blockY{ tile.minY }; blockY < tile.maxY; blockY += blockSize)
+	{
+		for (int blockX{ tile.minX }; blockX < tile.maxX; blockX += blockSize)
+		{
+			const int endY{ std::min(blockY + blockSize, tile.maxY) };
+			const int endX{ std::min(blockX + blockSize, tile.maxX) };
+			for (int py{ blockY }; py < endY; ++py)
 			{
-				ColorRGB finalColor{ };
-				float pixelDepth{};
+				for (int px{ blockX }; px < endX; ++px)
+				{
+					// The farthest sample keeps the depth buffer conservative for the occlusion history
+					const size_t pixelIdx{ m_pFramebuffer->GetPixelIdx(px, py) };
+					ColorRGB color{ m_pSampleBuffer->Resolve(px, py, pDepth[pixelIdx]) };
+					AddPixelToRGBBuffer(color, pixelIdx);
+				}
+			}
+		}
+	}
+}
 
-				const float screenY{ py + 0.5f };
-				const Vector3 pixelPos{ screenX, screenY, 1 };
+void Renderer::SelectLods(const Scene& scene)
+{
+	const std::vector<MeshInstance>& instances{ scene.GetInstances() };
+	const BVH& bvh{ scene.GetBVH() };
+	m_InstanceLods.resize(instances.size(), 0);
+
+	for (const uint32_t instanceIdx : m_VisibleInstances)
+	{
+		const MeshInstance& instance{ instances[instanceIdx] };
+		const std::span<const MeshLod> lods{ instance.pMesh->GetLods() };
+		uint8_t& lodIdx{ m_InstanceLods[instanceIdx] };
+		if (!m_Settings.isLodEnabled || lods.size() < 2)
+		{
+			lodIdx = 0;
+			continue;
+		}
 
-				// Checks whether or not the pixel is in the triangle and fills areaParallelVec
-				const bool inTriangle{ GeometryUtils::PixelInTriangle(m_TrigVertexVec, pixelPos, m_AreaParallelVec) };
+		// Screen pixels per world unit at the closest point of the bounding sphere
+		const AABB& bounds{ bvh.GetPrimitiveBounds(instanceIdx) };
+		const float radius{ (bounds.max - bounds.min).Magnitude() * 0.5f };
+		const float distance{ std::max((bounds.GetCenter() - m_Camera.origin).Magnitude() - radius, m_Camera.nearPlane) };
+		const Matrix& worldMatrix{ instance.worldMatrix };
+		const float maxScale{ std::max({ worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude(), worldMatrix.GetAxisZ().Magnitude() }) };
+		const float pixelsPerUnit{ m_Height / (2.f * m_Camera.fov * distance) * maxScale };
+		const auto getPixelError = [&lods, pixelsPerUnit](size_t idx) { return lods[idx].error * pixelsPerUnit; };
 
-				if (!inTriangle)
+		// Refine as soon as the error shows, coarsen only once the next level is clearly below the threshold
+		const float coarsenPixelError{ m_Settings.lodPixelError * (1.f - m_Settings.lodHysteresis) };
+		lodIdx = static_cast<uint8_t>(std::min(size_t{ lodIdx }, lods.size() - 1));
+		while (lodIdx > 0 && getPixelError(lodIdx) > m_Settings.lodPixelError)
+			--lodIdx;
+		while (lodIdx + 1u < lods.size() && getPixelError(lodIdx + 1u) < coarsenPixelError)
+			++lodIdx;
+	}
+}
+
+void Renderer::QueueDraws(const Scene& scene)
+{
+	const std::vector<MeshInstance>& instances{ scene.GetInstances() };
+	const BVH& bvh{ scene.GetBVH() };
+
+	const float nearPlane{ m_Camera.nearPlane };
+	const float farPlane{ m_Camera.farPlane };
+	const bool isGroupedByMaterial{ m_Settings.drawSortMode == DrawSortMode::MaterialFrontToBack };
+
+	m_DrawQueue.Clear();
+	for (const uint32_t instanceIdx : m_VisibleInstances)
+	{
+		const float viewDepth{ m_Camera.worldToCamera.TransformPoint(bvh.GetPrimitiveBounds(instanceIdx).GetCenter()).z };
+		const uint32_t group{ isGroupedByMaterial ? instances[instanceIdx].pMaterial->sortId : 0 };
+		m_DrawQueue.Submit(instanceIdx, group, (viewDepth - nearPlane) / (farPlane - nearPlane));
+	}
+
+	if (m_Settings.drawSortMode != DrawSortMode::Submission)
+		m_DrawQueue.Sort();
+}
+
+void Renderer::CullOccludedInstances(const Scene& scene, Frame& frame)
+{
+	const std::vector<MeshInstance>& instances{ scene.GetInstances() };
+	const BVH& bvh{ scene.GetBVH() };
+
+	m_OcclusionBuffer.Clear();
+	// The presented frame is the newest one that is sure to be rasterized
+	if (m_Settings.isTemporalOcclusionEnabled && m_pPresentedFrame && m_pPresentedFrame->hasOcclusionHistory)
+		ReprojectOcclusionHistory(*m_pPresentedFrame);
+
+	// The nearest occluders cover the most screen
+	m_Occluders.clear();
+	for (const uint32_t instanceIdx : m_VisibleInstances)
+	{
+		if (instances[instanceIdx].pOccluder)
+			m_Occluders.push_back({ (bvh.GetPrimitiveBounds(instanceIdx).GetCenter() - m_Camera.origin).SqrMagnitude(), instanceIdx });
+	}
+
+	const size_t nrOccluders{ std::min(m_Occluders.size(), size_t{ m_Settings.maxOccluders }) };
+	std::partial_sort(m_Occluders.begin(), m_Occluders.begin() + nrOccluders, m_Occluders.end());
+	for (size_t idx{}; idx < nrOccluders; ++idx)
+		RasterizeOccluder(instances[m_Occluders[idx].second], m_InstanceLods[m_Occluders[idx].second]);
+	frame.stats.occludersDrawn = static_cast<uint32_t>(nrOccluders);
+
+	// An occluder never hides itself, its box is always at least as close as its own depth
+	const size_t nrVisible{ m_VisibleInstances.size() };
+	std::erase_if(m_VisibleInstances, [this, &bvh](uint32_t instanceIdx) { return IsOccluded(bvh.GetPrimitiveBounds(instanceIdx)); });
+	frame.stats.instancesOccluded = static_cast<uint32_t>(nrVisible - m_VisibleInstances.size());
+}
+
+void Renderer::RasterizeOccluder(const MeshInstance& instance, uint32_t lodIdx)
+{
+	const Mesh& mesh{ *instance.pOccluder };
+	const Matrix worldViewMatrix{ instance.worldMatrix * m_Camera.worldToCamera };
+
+	const float scaleX{ static_cast<float>(m_OcclusionBuffer.GetWidth()) / m_Width };
+	const float scaleY{ static_cast<float>(m_OcclusionBuffer.GetHeight()) / m_Height };
+	const auto projectToOcclusionBuffer = [&](const Vector3& position)
+	{
+		Vector4 projected{ ProjectToScreen(worldViewMatrix.TransformPoint(position)) };
+		projected.x *= scaleX;
+		projected.y *= scaleY;
+		return projected;
+	};
+
+	m_OccluderVertices.resize(GetNrVertices(mesh));
+	ForEachVertexPosition(mesh, [&](size_t idx, const Vector3& position) { m_OccluderVertices[idx] = projectToOcclusionBuffer(position); });
+
+	// The LOD was picked for the drawn mesh, a separate occluder mesh may have fewer levels
+	const std::span<const uint32_t> indices{ mesh.GetLodIndices(std::min(size_t{ lodIdx }, mesh.GetNrLods() - 1)) };
+	ForEachTriangle(indices, mesh.primitiveTopology, [this](uint32_t idx0, uint32_t idx1, uint32_t idx2)
+	{
+		m_OcclusionBuffer.RasterizeTriangle(m_OccluderVertices[idx0], m_OccluderVertices[idx1], m_OccluderVertices[idx2]);
+	});
+}
+
+bool Renderer::IsOccluded(const AABB& worldBounds) const
+{
+	const float scaleX{ static_cast<float>(m_OcclusionBuffer.GetWidth()) / m_Width };
+	const float scaleY{ static_cast<float>(m_OcclusionBuffer.GetHeight()) / m_Height };
+
+	Vector2 screenMin{ FLT_MAX, FLT_MAX };
+	Vector2 screenMax{ -FLT_MAX, -FLT_MAX };
+	float nearestDepth{ FLT_MAX };
+	for (int cornerIdx{}; cornerIdx < 8; ++cornerIdx)
+	{
+		const Vector3 corner{
+			(cornerIdx & 1) ? worldBounds.max.x : worldBounds.min.x,
+			(cornerIdx & 2) ? worldBounds.max.y : worldBounds.min.y,
+			(cornerIdx & 4) ? worldBounds.max.z : worldBounds.min.z
+		};
+
+		// A box crossing the near plane can't be projected, and is too close to be hidden anyway
+		const Vector3 viewCorner{ m_Camera.worldToCamera.TransformPoint(corner) };
+		if (viewCorner.z < m_Camera.nearPlane)
+			return false;
+
+		const Vector4 projected{ ProjectToScreen(viewCorner) };
+		screenMin = { std::min(screenMin.x, projected.x * scaleX), std::min(screenMin.y, projected.y * scaleY) };
+		screenMax = { std::max(screenMax.x, projected.x * scaleX), std::max(screenMax.y, projected.y * scaleY) };
+		nearestDepth = std::min(nearestDepth, projected.z);
+	}
+
+	// Every pixel the box touches has to be covered by something closer than its nearest corner
+	const int minX{ std::clamp(static_cast<int>(std::floor(screenMin.x)), 0, m_OcclusionBuffer.GetWidth()) };
+	const int minY{ std::clamp(static_cast<int>(std::floor(screenMin.y)), 0, m_OcclusionBuffer.GetHeight()) };
+	const int maxX{ std::clamp(static_cast<int>(std::ceil(screenMax.x)), 0, m_OcclusionBuffer.GetWidth()) };
+	const int maxY{ std::clamp(static_cast<int>(std::ceil(screenMax.y)), 0, m_OcclusionBuffer.GetHeight()) };
+	if (minX >= maxX || minY >= maxY)
+		return false;
+
+	return m_OcclusionBuffer.IsOccluded(minX, minY, maxX, maxY, nearestDepth);
+}
+
+void Renderer::ReprojectOcclusionHistory(const Frame& historyFrame)
+{
+	const DepthBuffer& history{ historyFrame.occlusionHistory };
+	const Matrix historyToCurrent{ Matrix::Inverse(historyFrame.worldToCamera) * m_Camera.worldToCamera };
+
+	const int width{ history.GetWidth() };
+	const int height{ history.GetHeight() };
+	const float nearPlane{ m_Camera.nearPlane };
+	const float farPlane{ m_Camera.farPlane };
+
+	// Every history pixel gets scattered to one pixel, gaps stay empty so they never occlude anything.
+	// Pixels hit more than once keep the farthest depth, the only one last frame proves is covered all over
+	for (int py{}; py < height; ++py)
+	{
+		for (int px{}; px < width; ++px)
+		{
+			const float ndcDepth{ history.GetDepth(px, py) };
+			if (ndcDepth > 1.f)
+				continue;
+
+			// Inverse of ProjectToScreen for the history pixel center
+			const float viewDepth{ farPlane * nearPlane / (farPlane - ndcDepth * (farPlane - nearPlane)) };
+			const float ndcX{ (px + 0.5f) / width * 2.f - 1.f };
+			const float ndcY{ 1.f - (py + 0.5f) / height * 2.f };
+			const Vector3 historyPosition{ ndcX * m_Camera.fov * m_AspectRatio * viewDepth, ndcY * m_Camera.fov * viewDepth, viewDepth };
+
+			const Vector3 viewPosition{ historyToCurrent.TransformPoint(historyPosition) };
+			if (viewPosition.z < nearPlane)
+				continue;
+
+			const Vector4 projected{ ProjectToScreen(viewPosition) };
+			const int x{ static_cast<int>(std::floor(projected.x / m_Width * width)) };
+			const int y{ static_cast<int>(std::floor(projected.y / m_Height * height)) };
+			if (x >= 0 && x < width && y >= 0 && y < height)
+				m_OcclusionBuffer.SetDepthIfFarther(x, y, projected.z);
+		}
+	}
+}
+
+void Renderer::RenderInstance(DrawBatch& batch, const MeshInstance& instance, uint32_t lodIdx, const Frustum& frustum)
+{
+	const Mesh& mesh{ *instance.pMesh };
+
+	if (IsRenderedAsMeshlets(mesh))
+	{
+		RenderMeshlets(batch, instance, lodIdx, frustum);
+		return;
+	}
+
+	// Instances share the mesh, only the transformed copy is per instance
+	const bool isPacked{ !mesh.packedVertices.empty() };
+	const uint32_t nrVertices{ static_cast<uint32_t>(isPacked ? mesh.packedVertices.size() : mesh.GetVertices().size()) };
+	const uint32_t firstVertex{ batch.AddVertices(nrVertices) };
+	const std::span<Vertex_Out> verticesOut{ &batch.vertices[firstVertex], nrVertices };
+	if (isPacked)
+		VertexTransformationFunction(mesh.packedVertices, mesh.quantization, instance.worldMatrix, verticesOut);
+	else
+		VertexTransformationFunction(mesh.GetVertices(), instance.worldMatrix, verticesOut);
+
+	const uint32_t pixelPipelineIdx{ GetPixelPipelineIdx(*instance.pMaterial) };
+	ForEachTriangle(mesh.GetLodIndices(lodIdx), mesh.primitiveTopology, [this, &batch, &instance, firstVertex, pixelPipelineIdx](uint32_t idx0, uint32_t idx1, uint32_t idx2)
+	{
+		BinTriangle(batch, firstVertex + idx0, firstVertex + idx1, firstVertex + idx2, *instance.pMaterial, pixelPipelineIdx);
+	});
+}
+
+void Renderer::RenderMeshlets(DrawBatch& batch, const MeshInstance& instance, uint32_t lodIdx, const Frustum& frustum)
+{
+	const Mesh& mesh{ *instance.pMesh };
+	const Matrix& worldMatrix{ instance.worldMatrix };
+	const Matrix worldViewMatrix{ worldMatrix * m_Camera.worldToCamera };
+
+	// Culling happens in world space, the cones only stay exact under rotation and uniform scale
+	const float maxScale{ std::max({ worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude(), worldMatrix.GetAxisZ().Magnitude() }) };
+
+	const std::span<const Vertex> vertices{ mesh.GetVertices() };
+	const std::span<const uint32_t> meshletVertices{ mesh.GetMeshletVertices() };
+	const std::span<const uint8_t> meshletTriangles{ mesh.GetMeshletTriangles() };
+	const bool isPacked{ !mesh.packedVertices.empty() };
+	const uint32_t pixelPipelineIdx{ GetPixelPipelineIdx(*instance.pMaterial) };
+
+	// A meshlet is exactly one decode batch
+	std::array<PackedVertex, MeshletBuilder::MAX_VERTICES> packedBatch{};
+	std::array<Vertex, MeshletBuilder::MAX_VERTICES> decodedBatch{};
+
+	for (const Meshlet& meshlet : mesh.GetLodMeshlets(lodIdx))
+	{
+		++batch.stats.meshletsTotal;
+
+		if (!frustum.IsSphereVisible(worldMatrix.TransformPoint(meshlet.center), meshlet.radius * maxScale))
+		{
+			++batch.stats.meshletsFrustumCulled;
+			continue;
+		}
+
+		const Vector3 coneApex{ worldMatrix.TransformPoint(meshlet.coneApex) };
+		const Vector3 coneAxis{ worldMatrix.TransformVector(meshlet.coneAxis).Normalized() };
+		if (MeshletBuilder::IsBackFacing(coneApex, coneAxis, meshlet.coneCutoff, m_Camera.origin))
+		{
+			++batch.stats.meshletsConeCulled;
+			continue;
+		}
+
+		const uint32_t firstVertex{ batch.AddVertices(meshlet.vertexCount) };
+		Vertex_Out* pVerticesOut{ &batch.vertices[firstVertex] };
+
+		const uint32_t* pVertexIndices{ &meshletVertices[meshlet.vertexOffset] };
+		if (isPacked)
+		{
+			for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+				packedBatch[idx] = mesh.packedVertices[pVertexIndices[idx]];
+			VertexPacking::Decode(packedBatch.data(), meshlet.vertexCount, mesh.quantization, decodedBatch.data());
+
+			for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+				TransformVertex(decodedBatch[idx], worldViewMatrix, pVerticesOut[idx]);
+		}
+		else
+		{
+			for (uint32_t idx{}; idx < meshlet.vertexCount; ++idx)
+				TransformVertex(vertices[pVertexIndices[idx]], worldViewMatrix, pVerticesOut[idx]);
+		}
+
+		const uint8_t* pTriangles{ &meshletTriangles[meshlet.triangleOffset] };
+		for (uint32_t idx{}; idx < meshlet.triangleCount * 3; idx += 3)
+			BinTriangle(batch, firstVertex + pTriangles[idx], firstVertex + pTriangles[idx + 1], firstVertex + pTriangles[idx + 2], *instance.pMaterial, pixelPipelineIdx);
+	}
+}
+
+void Renderer::BinTriangle(DrawBatch& batch, uint32_t idx0, uint32_t idx1, uint32_t idx2, const Material& material, uint32_t pixelPipelineIdx)
+{
+	const Vertex_Out& v0{ batch.vertices[idx0] };
+	const Vertex_Out& v1{ batch.vertices[idx1] };
+	const Vertex_Out& v2{ batch.vertices[idx2] };
+
+	// Frustum culling, a vertex outside the depth range discards the whole triangle
+	const auto isOutsideDepth = [](const Vertex_Out& vertex) { return vertex.position.z < 0.f || vertex.position.z > 1.f; };
+	if (isOutsideDepth(v0) || isOutsideDepth(v1) || isOutsideDepth(v2))
+		return;
+
+	const Vector2 p0{ v0.position.x, v0.position.y };
+	const Vector2 p1{ v1.position.x, v1.position.y };
+	const Vector2 p2{ v2.position.x, v2.position.y };
+
+	// Back-face culling, also rejects degenerate triangles
+	if (Vector2::Cross(p1 - p0, p2 - p0) <= 0.f)
+		return;
+
+	// Slivers and specks that fall between pixel centers can't cover anything
+	const float sampleExtent{ m_pSampleBuffer->GetSampleCount() > 1 ? 0.5f : 0.f };
+	const TileRect pixels{ GetPixelBounds(p0, p1, p2, sampleExtent, { 0, 0, m_Width, m_Height }) };
+	if (pixels.IsEmpty())
+	{
+		++batch.stats.trianglesWithoutCoverage;
+		return;
+	}
+
+	// A larger index would spill into the batch bits of the visibility id and shade some other triangle
+	const uint32_t triangleIdx{ static_cast<uint32_t>(batch.triangles.size()) };
+	const bool hasVisibilityId{ !m_Settings.isVisibilityBufferEnabled || triangleIdx < MAX_VISIBILITY_BATCH_TRIANGLES };
+	assert(hasVisibilityId && "ERROR: too many triangles in one draw batch for the visibility buffer");
+	if (!hasVisibilityId)
+		return;
+
+	batch.triangles.push_back({ { idx0, idx1, idx2 }, pixelPipelineIdx, &material });
+	batch.bins.Add(triangleIdx, pixels, { std::min({ v0.position.z, v1.position.z, v2.position.z }), std::max({ v0.position.z, v1.position.z, v2.position.z }) });
+}
+
+uint32_t Renderer::GetPixelPipelineIdx(const Material& material) const
+{
+	RasterMode rasterMode{ RasterMode::SingleSample };
+	if (m_Settings.isVisibilityBufferEnabled)
+		rasterMode = RasterMode::Visibility;
+	else if (m_pSampleBuffer->GetSampleCount() > 1)
+		rasterMode = RasterMode::Multisample;
+
+	// The visibility pass still needs the shader config, ShadeVisibilityTile uses it
+	const uint32_t shaderConfigIdx{ PixelShading::GetShaderConfigIdx(material, m_Settings.shadingMode, m_Settings.isNormalMapEnabled, IsShadowMapUsed()) };
+	return static_cast<uint32_t>(rasterMode) * PixelShading::NR_SHADER_CONFIGS + shaderConfigIdx;
+}
+
+Renderer::RasterizeFunction Renderer::GetRasterizeFunction(uint32_t pixelPipelineIdx)
+{
+	// Visibility rasterization doesn't shade, so all its pipelines share one instantiation
+	static constexpr auto getShader = [](uint32_t idx)
+	{
+		const bool isVisibility{ idx / PixelShading::NR_SHADER_CONFIGS == static_cast<uint32_t>(RasterMode::Visibility) };
+		return isVisibility ? ShaderConfig{} : PixelShading::GetShaderConfig(idx % PixelShading::NR_SHADER_CONFIGS);
+	};
+
+	static constexpr std::array<RasterizeFunction, NR_PIXEL_PIPELINES> functions{ []<uint32_t... Indices>(std::integer_sequence<uint32_t, Indices...>)
+	{
+		return std::array<RasterizeFunction, NR_PIXEL_PIPELINES>{
+			&Renderer::RasterizeTriangle<static_cast<RasterMode>(Indices / PixelShading::NR_SHADER_CONFIGS), getShader(Indices)>...
+		};
+	}(std::make_integer_sequence<uint32_t, NR_PIXEL_PIPELINES>{}) };
+
+	return functions[pixelPipelineIdx];
+}
+
+template<Renderer::RasterMode Mode, ShaderConfig Shader>
+void Renderer::RasterizeTriangle(const Frame& frame, uint32_t batchIdx, uint32_t triangleIdx, const TileRect& tile, std::span<const ShadingPointLight> lights, RenderStats& stats)
+{
+	const DrawBatch& batch{ frame.batches[batchIdx] };
+	const BinnedTriangle& triangle{ batch.triangles[triangleIdx] };
+	const Vertex_Out& v0{ batch.vertices[triangle.vertexIndices[0]] };
+	const Vertex_Out& v1{ batch.vertices[triangle.vertexIndices[1]] };
+	const Vertex_Out& v2{ batch.vertices[triangle.vertexIndices[2]] };
+	const Material& material{ *triangle.pMaterial };
+
+	const Vector2 p0{ v0.position.x, v0.position.y };
+	const Vector2 p1{ v1.position.x, v1.position.y };
+	const Vector2 p2{ v2.position.x, v2.position.y };
+
+	// Binning already culled back faces, so the area is positive
+	const float invAreaTrig{ 1.f / Vector2::Cross(p1 - p0, p2 - p0) };
+
+	constexpr bool isVisibilityPass{ Mode == RasterMode::Visibility };
+	constexpr bool isDepthOnlyPass{ Mode == RasterMode::DepthOnly };
+	constexpr bool isMultisampled{ Mode == RasterMode::Multisample };
+	const uint32_t visibilityId{ batchIdx << VISIBILITY_BATCH_SHIFT | triangleIdx };
+	const uint32_t sampleCount{ m_pSampleBuffer->GetSampleCount() };
+	// With MSAA every pixel whose samples are within half a pixel of its center can be touched
+	constexpr float sampleExtent{ isMultisampled ? 0.5f : 0.f };
+
+	// The bounds can still miss every pixel center of this tile
+	const TileRect pixels{ GetPixelBounds(p0, p1, p2, sampleExtent, tile) };
+	if (pixels.IsEmpty())
+		return;
+	const int startX{ pixels.minX };
+	const int startY{ pixels.minY };
+	const int endX{ pixels.maxX };
+	const int endY{ pixels.maxY };
+
+	// Barycentric weights, every one of them is positive inside the triangle
+	const EdgeFunction edge0{ EdgeFunction::Create(p1, p2, invAreaTrig) };
+	const EdgeFunction edge1{ EdgeFunction::Create(p2, p0, invAreaTrig) };
+	const EdgeFunction edge2{ EdgeFunction::Create(p0, p1, invAreaTrig) };
+
+	// Perspective correct interpolation works on attribute / viewDepth
+	const Vector3 invDepths{ 1.f / v0.position.w, 1.f / v1.position.w, 1.f / v2.position.w };
+
+	// Every pixel drawn here is in tile, which is one block of the tiled framebuffer
+	const size_t tileFirstPixel{ m_pFramebuffer->GetPixelIdx(tile.minX, tile.minY) };
+	const auto getPixelIdx = [&](int px, int py)
+	{
+		return tileFirstPixel + static_cast<size_t>(py - tile.minY) * TiledFramebuffer::TILE_SIZE + (px - tile.minX);
+	};
+
+	// Shaded 4 at a time, always before this returns. The pixels of one triangle never overlap, so the delay can't change the result
+	PendingPixels pendingPixels{};
+	const auto shadePendingPixels = [&]()
+	{
+		if (pendingPixels.count == 0)
+			return;
+
+		const auto shadeQuad = [&](__m128 weight0, __m128 weight1, __m128 weight2)
+		{
+			return PixelShading::ShadeQuad<Shader>(v0, v1, v2, invDepths, material, frame.shading, lights, { weight0, weight1, weight2 });
+		};
+		pendingPixels.Shade(shadeQuad, [&](int lane, ColorRGB color)
+		{
+			if constexpr (!isMultisampled)
+			{
+				AddPixelToRGBBuffer(color, pendingPixels.pixelIdx[lane]);
+				return;
+			}
+
+			color.MaxToOne();
+			const uint32_t packedColor{ SampleBuffer::PackColor(color) };
+			uint32_t* pSampleColors{ m_pSampleBuffer->GetColor(pendingPixels.x[lane], pendingPixels.y[lane]) };
+			for (uint32_t mask{ pendingPixels.sampleMask[lane] }; mask; mask &= mask - 1)
+				pSampleColors[std::countr_zero(mask)] = packedColor;
+		});
+	};
+
+	const auto shadePixel = [&](int px, int py, float weight0, float weight1, float weight2)
+	{
+		// NDC depth is linear in screen space
+		const float pixelDepth{ weight0 * v0.position.z + weight1 * v1.position.z + weight2 * v2.position.z };
+		const size_t pixelIdx{ getPixelIdx(px, py) };
+		if (!AddPixelToDepthBuffer(pixelDepth, pixelIdx) || isDepthOnlyPass)
+			return;
+
+		// Shading waits for ShadeVisibilityTile, once the closest triangle of every pixel is known
+		if constexpr (isVisibilityPass)
+		{
+			m_VisibilityBuffer[pixelIdx] = visibilityId;
+			return;
+		}
+		++stats.pixelsShaded;
+
+		if (pendingPixels.Add(pixelIdx, px, py, weight0, weight1, weight2, 0))
+			shadePendingPixels();
+	};
+
+	// The edge functions and depth at every sample are the pixel center's value plus a fixed offset
+	alignas(16) float sampleOffsets0[SampleBuffer::MAX_SAMPLES]{};
+	alignas(16) float sampleOffsets1[SampleBuffer::MAX_SAMPLES]{};
+	alignas(16) float sampleOffsets2[SampleBuffer::MAX_SAMPLES]{};
+	alignas(16) float depthOffsets[SampleBuffer::MAX_SAMPLES]{};
+	const uint32_t fullCoverage{ (1u << sampleCount) - 1 };
+	if constexpr (isMultisampled)
+	{
+		const float depthA{ edge0.a * v0.position.z + edge1.a * v1.position.z + edge2.a * v2.position.z };
+		const float depthB{ edge0.b * v0.position.z + edge1.b * v1.position.z + edge2.b * v2.position.z };
+
+		const std::span<const Vector2> samplePositions{ SampleBuffer::GetSamplePositions(sampleCount) };
+		for (uint32_t sampleIdx{}; sampleIdx < sampleCount; ++sampleIdx)
+		{
+			const Vector2& offset{ samplePositions[sampleIdx] };
+			sampleOffsets0[sampleIdx] = edge0.a * offset.x + edge0.b * offset.y;
+			sampleOffsets1[sampleIdx] = edge1.a * offset.x + edge1.b * offset.y;
+			sampleOffsets2[sampleIdx] = edge2.a * offset.x + edge2.b * offset.y;
+			depthOffsets[sampleIdx] = depthA * offset.x + depthB * offset.y;
+		}
+	}
+
+	// 4 samples per SIMD step, lanes past sampleCount get masked off
+	const auto getSampleCoverage = [&](float weight0, float weight1, float weight2)
+	{
+		const __m128 pixelWeight0{ _mm_set1_ps(weight0) };
+		const __m128 pixelWeight1{ _mm_set1_ps(weight1) };
+		const __m128 pixelWeight2{ _mm_set1_ps(weight2) };
+		const __m128 zero{ _mm_setzero_ps() };
+
+		uint32_t coverageMask{};
+		for (uint32_t firstSample{}; firstSample < sampleCount; firstSample += 4)
+		{
+			const __m128 sampleWeight0{ _mm_add_ps(pixelWeight0, _mm_load_ps(sampleOffsets0 + firstSample)) };
+			const __m128 sampleWeight1{ _mm_add_ps(pixelWeight1, _mm_load_ps(sampleOffsets1 + firstSample)) };
+			const __m128 sampleWeight2{ _mm_add_ps(pixelWeight2, _mm_load_ps(sampleOffsets2 + firstSample)) };
+			const __m128 isInside{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(sampleWeight0, zero), _mm_cmpge_ps(sampleWeight1, zero)), _mm_cmpge_ps(sampleWeight2, zero)) };
+			coverageMask |= static_cast<uint32_t>(_mm_movemask_ps(isInside)) << firstSample;
+		}
+		return coverageMask & fullCoverage;
+	};
+
+	// Depth is tested per sample, the color is shaded once at the pixel center and copied to every sample that passed
+	const auto shadeSamples = [&](int px, int py, float weight0, float weight1, float weight2, uint32_t coverageMask)
+	{
+		const float centerDepth{ weight0 * v0.position.z + weight1 * v1.position.z + weight2 * v2.position.z };
+		float* pSampleDepths{ m_pSampleBuffer->GetDepth(px, py) };
+
+		uint32_t passedMask{};
+		if (sampleCount >= 4)
+		{
+			// A pixel's samples are 16 byte aligned once there are 4 or more of them
+			const __m128 pixelDepth{ _mm_set1_ps(centerDepth) };
+			for (uint32_t firstSample{}; firstSample < sampleCount; firstSample += 4)
+			{
+				const uint32_t laneMask{ (coverageMask >> firstSample) & 0xF };
+				if (!laneMask)
 					continue;
 
-				// Figure out the depth and color of a pixel on an object (barycentric coordinates reversed)
-				for (int interpolateIdx{}; interpolateIdx < nrTrigVertices; ++interpolateIdx)
-				{
-					const float weight{ (m_AreaParallelVec[interpolateIdx] * 0.5f) / areaTrig };
-					const Vertex& vertex{ screenSpaceVec[(trigIdx * nrTrigVertices + interpolateIdx)] };
+				const __m128 isCovered{ _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_and_si128(_mm_set1_epi32(laneMask), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128())) };
+				const __m128 sampleDepth{ _mm_add_ps(pixelDepth, _mm_load_ps(depthOffsets + firstSample)) };
+				const __m128 storedDepth{ _mm_load_ps(pSampleDepths + firstSample) };
+				const __m128 isPassed{ _mm_and_ps(isCovered, _mm_cmpge_ps(storedDepth, sampleDepth)) };
 
-					finalColor += vertex.color * weight;
-					pixelDepth += vertex.position.z * weight;
+				_mm_store_ps(pSampleDepths + firstSample, _mm_or_ps(_mm_and_ps(isPassed, sampleDepth), _mm_andnot_ps(isPassed, storedDepth)));
+				passedMask |= static_cast<uint32_t>(_mm_movemask_ps(isPassed)) << firstSample;
+			}
+		}
+		else
+		{
+			for (uint32_t mask{ coverageMask }; mask; mask &= mask - 1)
+			{
+				const int sampleIdx{ std::countr_zero(mask) };
+				const float sampleDepth{ centerDepth + depthOffsets[sampleIdx] };
+				if (pSampleDepths[sampleIdx] >= sampleDepth)
+				{
+					pSampleDepths[sampleIdx] = sampleDepth;
+					passedMask |= 1u << sampleIdx;
 				}
-				if (AddPixelToDepthBuffer(pixelDepth, px, py))
-					AddPixelToRGBBuffer(finalColor, px, py);
 			}
 		}
+		if (!passedMask)
+			return;
+		++stats.pixelsShaded;
+
+		// Shaded once for all of them, the color goes to every sample that passed
+		if (pendingPixels.Add(0, px, py, weight0, weight1, weight2, passedMask))
+			shadePendingPixels();
+	};
+
+	// Distant dense meshes are mostly triangles like this, where the loop setup below would cost more than the pixels
+	if (!isMultisampled && endX - startX <= SMALL_TRIANGLE_SIZE && endY - startY <= SMALL_TRIANGLE_SIZE)
+	{
+		++stats.trianglesSmall;
+
+		// One coverage bit per pixel center, a row of 4 per SIMD step
+		const __m128 screenX{ _mm_add_ps(_mm_set1_ps(static_cast<float>(startX)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)) };
+		const __m128 columnWeight0{ _mm_mul_ps(_mm_set1_ps(edge0.a), screenX) };
+		const __m128 columnWeight1{ _mm_mul_ps(_mm_set1_ps(edge1.a), screenX) };
+		const __m128 columnWeight2{ _mm_mul_ps(_mm_set1_ps(edge2.a), screenX) };
+		const __m128 zero{ _mm_setzero_ps() };
+
+		alignas(16) float weights0[SMALL_TRIANGLE_SIZE * SMALL_TRIANGLE_SIZE];
+		alignas(16) float weights1[SMALL_TRIANGLE_SIZE * SMALL_TRIANGLE_SIZE];
+		alignas(16) float weights2[SMALL_TRIANGLE_SIZE * SMALL_TRIANGLE_SIZE];
+
+		uint32_t coverageMask{};
+		for (int row{}; row < endY - startY; ++row)
+		{
+			const float screenY{ startY + row + 0.5f };
+			const __m128 weight0{ _mm_add_ps(columnWeight0, _mm_set1_ps(edge0.b * screenY + edge0.c)) };
+			const __m128 weight1{ _mm_add_ps(columnWeight1, _mm_set1_ps(edge1.b * screenY + edge1.c)) };
+			const __m128 weight2{ _mm_add_ps(columnWeight2, _mm_set1_ps(edge2.b * screenY + edge2.c)) };
+			const __m128 isInside{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(weight0, zero), _mm_cmpge_ps(weight1, zero)), _mm_cmpge_ps(weight2, zero)) };
+
+			_mm_store_ps(weights0 + row * SMALL_TRIANGLE_SIZE, weight0);
+			_mm_store_ps(weights1 + row * SMALL_TRIANGLE_SIZE, weight1);
+			_mm_store_ps(weights2 + row * SMALL_TRIANGLE_SIZE, weight2);
+			coverageMask |= static_cast<uint32_t>(_mm_movemask_ps(isInside)) << (row * SMALL_TRIANGLE_SIZE);
+		}
+		// Lanes right of endX are outside the bounds, or even the screen
+		coverageMask &= ((1u << (endX - startX)) - 1) * 0x1111u;
+
+		while (coverageMask)
+		{
+			const int bitIdx{ std::countr_zero(coverageMask) };
+			coverageMask &= coverageMask - 1;
+			shadePixel(startX + bitIdx % SMALL_TRIANGLE_SIZE, startY + bitIdx / SMALL_TRIANGLE_SIZE, weights0[bitIdx], weights1[bitIdx], weights2[bitIdx]);
+		}
+		shadePendingPixels();
+		return;
 	}
 
-	//@END
-	//Update SDL Surface
-	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-	SDL_UpdateWindowSurface(m_pWindow);
+	// Walk aligned blocks, most blocks of a large triangle are either fully inside or fully outside it
+	for (int blockY{ startY & ~(RASTER_BLOCK_SIZE - 1) }; blockY < endY; blockY += RASTER_BLOCK_SIZE)
+	{
+		const int blockStartY{ std::max(blockY, startY) };
+		const int blockEndY{ std::min(blockY + RASTER_BLOCK_SIZE, endY) };
+
+		for (int blockX{ startX & ~(RASTER_BLOCK_SIZE - 1) }; blockX < endX; blockX += RASTER_BLOCK_SIZE)
+		{
+			const int blockStartX{ std::max(blockX, startX) };
+			const int blockEndX{ std::min(blockX + RASTER_BLOCK_SIZE, endX) };
+
+			// The edge functions are linear, so their extremes over the block's samples are at its corners
+			const Vector2 minSample{ blockStartX + 0.5f - sampleExtent, blockStartY + 0.5f - sampleExtent };
+			const Vector2 maxSample{ blockEndX - 0.5f + sampleExtent, blockEndY - 0.5f + sampleExtent };
+			if (edge0.GetMax(minSample, maxSample) < 0.f || edge1.GetMax(minSample, maxSample) < 0.f || edge2.GetMax(minSample, maxSample) < 0.f)
+			{
+				++stats.blocksRejected;
+				continue;
+			}
+			const bool isCovered{ edge0.GetMin(minSample, maxSample) >= 0.f && edge1.GetMin(minSample, maxSample) >= 0.f && edge2.GetMin(minSample, maxSample) >= 0.f };
+			++(isCovered ? stats.blocksAccepted : stats.blocksPartial);
+
+			for (int py{ blockStartY }; py < blockEndY; ++py)
+			{
+				const float screenY{ py + 0.5f };
+				const float rowWeight0{ edge0.b * screenY + edge0.c };
+				const float rowWeight1{ edge1.b * screenY + edge1.c };
+				const float rowWeight2{ edge2.b * screenY + edge2.c };
+
+				for (int px{ blockStartX }; px < blockEndX; ++px)
+				{
+					const float screenX{ px + 0.5f };
+					const float weight0{ edge0.a * screenX + rowWeight0 };
+					const float weight1{ edge1.a * screenX + rowWeight1 };
+					const float weight2{ edge2.a * screenX + rowWeight2 };
+
+					if constexpr (isMultisampled)
+					{
+						const uint32_t coverageMask{ isCovered ? fullCoverage : getSampleCoverage(weight0, weight1, weight2) };
+						if (coverageMask)
+							shadeSamples(px, py, weight0, weight1, weight2, coverageMask);
+					}
+					else
+					{
+						if (!isCovered && (weight0 < 0.f || weight1 < 0.f || weight2 < 0.f))
+							continue;
+
+						shadePixel(px, py, weight0, weight1, weight2);
+					}
+				}
+			}
+		}
+	}
+	shadePendingPixels();
 }
 
-void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertexVec_in, std::vector<Vertex>& vertexVec_out) const
+void Renderer::ShadeVisibilityTile(const Frame& frame, const TileRect& tile, std::span<const ShadingPointLight> lights, RenderStats& stats)
 {
-	//Todo > W1 Projection Stage
-	const int nrVertices{ static_cast<int>(vertexVec_in.size()) };
-	for (int idx{}; idx < nrVertices; ++idx)
+	// Neighbouring pixels mostly hit the same triangle, so its setup is kept until the id changes
+	uint32_t setupId{ EMPTY_VISIBILITY_ID };
+	std::array<const Vertex_Out*, 3> corners{};
+	const Material* pMaterial{};
+	PixelShading::ShadeFunction pShadeQuad{};
+	Vector3 invDepths{};
+	EdgeFunction edge0{};
+	EdgeFunction edge1{};
+	EdgeFunction edge2{};
+
+	// Pixels of the set up triangle, shaded 4 at a time
+	PendingPixels pendingPixels{};
+	const auto shadePendingPixels = [&]()
+	{
+		if (pendingPixels.count == 0)
+			return;
+
+		// Through a pointer, per triangle, while the raster pass is instantiated per pipeline
+		const auto shadeQuad = [&](__m128 weight0, __m128 weight1, __m128 weight2)
+		{
+			return pShadeQuad(*corners[0], *corners[1], *corners[2], invDepths, *pMaterial, frame.shading, lights, { weight0, weight1, weight2 });
+		};
+		pendingPixels.Shade(shadeQuad, [&](int lane, ColorRGB color)
+		{
+			AddPixelToRGBBuffer(color, pendingPixels.pixelIdx[lane]);
+		});
+	};
+
+	for (int py{ tile.minY }; py < tile.maxY; ++py)
 	{
-		Vector3 vertex{ m_Camera.worldToCamera.TransformPoint(vertexVec_in[idx].position) };
+		const float screenY{ py + 0.5f };
+		const size_t rowFirstPixel{ m_pFramebuffer->GetPixelIdx(tile.minX, py) };
+		for (int px{ tile.minX }; px < tile.maxX; ++px)
+		{
+			const size_t pixelIdx{ rowFirstPixel + (px - tile.minX) };
+			const uint32_t visibilityId{ m_VisibilityBuffer[pixelIdx] };
+			if (visibilityId == EMPTY_VISIBILITY_ID)
+				continue;
 
-		// Add perspective
-		vertex.x /= vertex.z;
-		vertex.y /= vertex.z;
+			if (visibilityId != setupId)
+			{
+				shadePendingPixels();
+				setupId = visibilityId;
+				const DrawBatch& batch{ frame.batches[visibilityId >> VISIBILITY_BATCH_SHIFT] };
+				const BinnedTriangle& triangle{ batch.triangles[visibilityId & ((1u << VISIBILITY_BATCH_SHIFT) - 1)] };
+				for (size_t corner{}; corner < 3; ++corner)
+					corners[corner] = &batch.vertices[triangle.vertexIndices[corner]];
+				pMaterial = triangle.pMaterial;
+				pShadeQuad = PixelShading::GetShadeFunction(triangle.pixelPipelineIdx % PixelShading::NR_SHADER_CONFIGS);
 
-		// Account for screen dimensions and fov
-		vertex.x /= m_Camera.fov * m_AspectRatio;
-		vertex.y /= m_Camera.fov;
+				// Same edge setup as the raster pass, so the weights come out identical
+				const Vector2 p0{ corners[0]->position.x, corners[0]->position.y };
+				const Vector2 p1{ corners[1]->position.x, corners[1]->position.y };
+				const Vector2 p2{ corners[2]->position.x, corners[2]->position.y };
+				const float invAreaTrig{ 1.f / Vector2::Cross(p1 - p0, p2 - p0) };
+				edge0 = EdgeFunction::Create(p1, p2, invAreaTrig);
+				edge1 = EdgeFunction::Create(p2, p0, invAreaTrig);
+				edge2 = EdgeFunction::Create(p0, p1, invAreaTrig);
+				invDepths = { 1.f / corners[0]->position.w, 1.f / corners[1]->position.w, 1.f / corners[2]->position.w };
+			}
 
-		// NDC (Normalized Device Coordinates) ===> Screen space
-		vertex.x = (vertex.x + 1) * 0.5f * m_Width;
-		vertex.y = (1 - vertex.y) * 0.5f * m_Height;
+			const float screenX{ px + 0.5f };
+			const float weight0{ edge0.a * screenX + (edge0.b * screenY + edge0.c) };
+			const float weight1{ edge1.a * screenX + (edge1.b * screenY + edge1.c) };
+			const float weight2{ edge2.a * screenX + (edge2.b * screenY + edge2.c) };
 
-		vertexVec_out[idx].position = vertex;
-		vertexVec_out[idx].color = vertexVec_in[idx].color;
+			if (pendingPixels.Add(pixelIdx, px, py, weight0, weight1, weight2, 0))
+				shadePendingPixels();
+			++stats.pixelsShaded;
+		}
 	}
+	shadePendingPixels();
+}
+
+void Renderer::VertexTransformationFunction(std::span<const Vertex> vertices_in, const Matrix& worldMatrix, std::span<Vertex_Out> vertices_out) const
+{
+	const Matrix worldViewMatrix{ worldMatrix * m_Camera.worldToCamera };
+
+	const uint32_t nrVertices{ static_cast<uint32_t>(vertices_in.size()) };
+	JobSystem::GetInstance().ParallelFor(nrVertices, VERTEX_JOB_SIZE, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t idx{ begin }; idx < end; ++idx)
+			TransformVertex(vertices_in[idx], worldViewMatrix, vertices_out[idx]);
+	});
+}
+
+void Renderer::VertexTransformationFunction(std::span<const PackedVertex> vertices_in, const VertexQuantization& quantization, const Matrix& worldMatrix, std::span<Vertex_Out> vertices_out) const
+{
+	const Matrix worldViewMatrix{ worldMatrix * m_Camera.worldToCamera };
+
+	// Small enough to stay in L1 between decode and transform
+	constexpr uint32_t batchSize{ 64 };
+	static_assert(VERTEX_JOB_SIZE % batchSize == 0);
+
+	const uint32_t nrVertices{ static_cast<uint32_t>(vertices_in.size()) };
+	JobSystem::GetInstance().ParallelFor(nrVertices, VERTEX_JOB_SIZE, [&](uint32_t begin, uint32_t end)
+	{
+		std::array<Vertex, batchSize> decodedBatch{};
+		for (uint32_t batchStart{ begin }; batchStart < end; batchStart += batchSize)
+		{
+			const uint32_t nrBatchVertices{ std::min(batchSize, end - batchStart) };
+			VertexPacking::Decode(vertices_in.data() + batchStart, nrBatchVertices, quantization, decodedBatch.data());
+
+			for (uint32_t idx{}; idx < nrBatchVertices; ++idx)
+				TransformVertex(decodedBatch[idx], worldViewMatrix, vertices_out[batchStart + idx]);
+		}
+	});
+}
+
+void Renderer::TransformVertex(const Vertex& vertex_in, const Matrix& worldViewMatrix, Vertex_Out& vertex_out) const
+{
+	// Shading happens in view space, where the camera sits at the origin
+	const Vector3 viewPosition{ worldViewMatrix.TransformPoint(vertex_in.position) };
+	vertex_out.position = ProjectToScreen(viewPosition);
+	vertex_out.color = vertex_in.color;
+	vertex_out.uv = vertex_in.uv;
+	// Only exact under rotation and uniform scale, like the meshlet cone culling
+	vertex_out.normal = worldViewMatrix.TransformVector(vertex_in.normal);
+	vertex_out.tangent = worldViewMatrix.TransformVector(vertex_in.tangent);
+	vertex_out.viewDirection = viewPosition;
 }
 
-void Renderer::UpdateBuffer()
+Vector4 Renderer::ProjectToScreen(const Vector3& viewPosition) const
 {
-	const int nrPixels{ m_Width * m_Height };
-	for (int idx{}; idx < nrPixels; ++idx)
-		m_pDepthBufferPixels[idx] = std::numeric_limits<float>::max();
+	Vector3 vertex{ viewPosition };
+	const float viewDepth{ vertex.z };
+
+	// Add perspective
+	vertex.x /= viewDepth;
+	vertex.y /= viewDepth;
+
+	// Account for screen dimensions and fov
+	vertex.x /= m_Camera.fov * m_AspectRatio;
+	vertex.y /= m_Camera.fov;
+
+	// NDC (Normalized Device Coordinates) ===> Screen space
+	vertex.x = (vertex.x + 1) * 0.5f * m_Width;
+	vertex.y = (1 - vertex.y) * 0.5f * m_Height;
 
-	SDL_FillRect(m_pBackBuffer, nullptr, GetSDLRGB(m_ClearColor));
+	// Same depth mapping as a left handed perspective projection: 0 at the near plane, 1 at the far plane
+	const float nearPlane{ m_Camera.nearPlane };
+	const float farPlane{ m_Camera.farPlane };
+	const float ndcDepth{ (farPlane - (farPlane * nearPlane) / viewDepth) / (farPlane - nearPlane) };
+
+	return { vertex.x, vertex.y, ndcDepth, viewDepth };
 }
 
-void Renderer::AddPixelToRGBBuffer(ColorRGB& color, int x, int y) const
+void Renderer::AddPixelToRGBBuffer(ColorRGB& color, size_t pixelIdx) const
 {
 	//Update Color in Buffer
 	color.MaxToOne();
 
-	m_pBackBufferPixels[x + (y * m_Width)] = GetSDLRGB(color);
+	m_pFramebuffer->GetColors()[pixelIdx] = GetSDLRGB(color);
 }
 
-bool Renderer::AddPixelToDepthBuffer(float depth, int x, int y) const
+bool Renderer::AddPixelToDepthBuffer(float depth, size_t pixelIdx) const
 {
-	const int idx{ x + (y * m_Width) };
-	const bool isCloser{ m_pDepthBufferPixels[idx] >= depth };
+	float& storedDepth{ m_pFramebuffer->GetDepth()[pixelIdx] };
+	const bool isCloser{ storedDepth >= depth };
 	if (isCloser)
-		m_pDepthBufferPixels[idx] = depth;
+		storedDepth = depth;
 
 	return isCloser;
 }
 
 Uint32 Renderer::GetSDLRGB(const ColorRGB& color) const
 {
-	return SDL_MapRGB(m_pBackBuffer->format,
+	return SDL_MapRGB(m_Frames[0].pColorBuffer->format,
 		static_cast<uint8_t>(color.r * 255),
 		static_cast<uint8_t>(color.g * 255),
 		static_cast<uint8_t>(color.b * 255));
 }
 
-Rect Renderer::GetBoundingBox(const std::vector<Vector3>&vertexVec) const
+bool Renderer::SaveBufferToImage()
 {
-	Vector2 bottomLeft{ vertexVec[0] };
-	Vector2 topRight{ vertexVec[0] };
-
-	for (const Vector3& vertex : vertexVec)
-	{
-		bottomLeft.x = std::min(bottomLeft.x, vertex.x);
-		bottomLeft.y = std::min(bottomLeft.y, vertex.y);
-		topRight.x = std::max(topRight.x, vertex.x);
-		topRight.y = std::max(topRight.y, vertex.y);
-	}
+	Flush();
 
-	return Rect{ bottomLeft, topRight };
-}
-
-bool Renderer::SaveBufferToImage() const
-{
-	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+	// Nothing rendered yet, reported like a failed save
+	if (!m_pPresentedFrame)
+		return true;
+	return SDL_SaveBMP(m_pPresentedFrame->pColorBuffer, "Rasterizer_ColorBuffer.bmp");
 }
@@ -1,10 +1,21 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "DepthBuffer.h"
+#include "DrawQueue.h"
+#include "JobSystem.h"
+#include "PixelShading.h"
+#include "RenderSettings.h"
+#include "RenderStats.h"
+#include "TileBins.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -17,6 +28,11 @@ namespace dae
 	struct Vertex;
 	class Timer;
 	class Scene;
+	class SampleBuffer;
+	class SwapChain;
+	class TiledFramebuffer;
+	struct Material;
+	struct MeshInstance;
 
 	class Renderer final
 	{
@@ -30,27 +46,214 @@ namespace dae
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Update(Timer* pTimer);
-		void Render();
+		// Bins the scene and starts rasterizing it in the background. Frames are presented once
+		// more than RenderSettings::frameLatency of them are in flight
+		void Render(const Scene& scene);
+		// Presents every frame still in flight and shows the last one
+		void Flush();
 
-		bool SaveBufferToImage() const;
+		// Saves the latest frame, flushing first
+		bool SaveBufferToImage();
 
-		void VertexTransformationFunction(const std::vector<Vertex>& vertexVec_in, std::vector<Vertex>& vertexVec_out) const;
+		const RenderStats& GetStats() const { return m_Stats; }
+		const RenderSettings& GetSettings() const { return m_Settings; }
+		void SetSettings(const RenderSettings& settings);
+
+		// vertices_out needs room for every input vertex
+		void VertexTransformationFunction(std::span<const Vertex> vertices_in, const Matrix& worldMatrix, std::span<Vertex_Out> vertices_out) const;
+		// Decodes the packed vertices in small SIMD batches right before transforming them
+		void VertexTransformationFunction(std::span<const PackedVertex> vertices_in, const VertexQuantization& quantization, const Matrix& worldMatrix, std::span<Vertex_Out> vertices_out) const;
 
 	private:
-		void UpdateBuffer();
-		void AddPixelToRGBBuffer(ColorRGB& color, int x, int y) const;
-		bool AddPixelToDepthBuffer(float depth, int x, int y) const;
+		static constexpr int OCCLUSION_BUFFER_WIDTH{ 256 };
+		static constexpr int OCCLUSION_BUFFER_HEIGHT{ 128 };
+		static constexpr int SHADOW_MAP_SIZE{ 1024 };
+		// Rows of the shadow map one job rasterizes
+		static constexpr int SHADOW_BAND_HEIGHT{ 64 };
+		// frameLatency + 1 frames can be in flight
+		static constexpr uint32_t MAX_FRAMES_IN_FLIGHT{ RenderSettings::MAX_FRAME_LATENCY + 1 };
+
+		// Draw batches per thread, more than one so a batch of heavy meshes doesn't hold up the rest
+		static constexpr uint32_t DRAW_BATCHES_PER_THREAD{ 4 };
+		static constexpr uint32_t MAX_DRAW_BATCHES{ 64 };
+		// Visibility ids are the batch index shifted by this, or'ed with the triangle index in that batch
+		static constexpr uint32_t VISIBILITY_BATCH_SHIFT{ 24 };
+		static_assert(MAX_DRAW_BATCHES <= (1u << (32 - VISIBILITY_BATCH_SHIFT)) - 1, "the last batch could produce the empty visibility id");
+		// The triangle index has the bits below VISIBILITY_BATCH_SHIFT, binning stops there while the visibility buffer is on
+		static constexpr uint32_t MAX_VISIBILITY_BATCH_TRIANGLES{ 1u << VISIBILITY_BATCH_SHIFT };
+
+		// How a triangle gets rasterized, a template argument of RasterizeTriangle
+		enum class RasterMode
+		{
+			SingleSample,
+			Multisample,
+			Visibility,		// Depth and visibility ids only, shaded later by ShadeVisibilityTile
+			DepthOnly		// The forward path's depth pre-pass, see RasterizeTileDepth. Not a pixel pipeline
+		};
+		static constexpr uint32_t NR_RASTER_MODES{ static_cast<uint32_t>(RasterMode::Visibility) + 1 };
+		// A raster mode and a PixelShading shader config, see GetPixelPipelineIdx
+		static constexpr uint32_t NR_PIXEL_PIPELINES{ NR_RASTER_MODES * PixelShading::NR_SHADER_CONFIGS };
+
+		// Its corners index DrawBatch::vertices
+		struct BinnedTriangle
+		{
+			std::array<uint32_t, 3> vertexIndices{};
+			// Same for every triangle of a draw
+			uint32_t pixelPipelineIdx{};
+			const Material* pMaterial{};
+		};
+
+		// A contiguous run of the draw queue, transformed and binned by one job without sharing anything with the other batches.
+		// A tile draws the triangles of every batch in batch order, which is exactly the draw order
+		struct DrawBatch
+		{
+			// Only the first nrVertices are this frame's, the vector never shrinks so its elements don't get initialized every frame
+			std::vector<Vertex_Out> vertices{};
+			uint32_t nrVertices{};
+			std::vector<BinnedTriangle> triangles{};
+			TileBins bins{};
+			// Culling counters, summed into Frame::stats
+			RenderStats stats{};
+
+			// Returns the index of the first of count new vertices
+			uint32_t AddVertices(uint32_t count)
+			{
+				const uint32_t firstVertex{ nrVertices };
+				nrVertices += count;
+				if (vertices.size() < nrVertices)
+					vertices.resize(nrVertices);
+				return firstVertex;
+			}
+		};
+
+		// Conservative screen footprint of a point light's sphere, in pixels and NDC depth
+		struct PointLightBounds
+		{
+			float minX{};
+			float minY{};
+			float maxX{};
+			float maxY{};
+			DepthRange depth{};
+		};
+
+		// Everything a frame needs between binning and present, so the next frame can be binned while this one rasterizes
+		struct Frame
+		{
+			RenderSettings settings{};
+			RenderStats stats{};
+			Matrix worldToCamera{};
+			ShadingConstants shading{};
+			// The point lights that can reach the screen, with their bounds at the same index
+			std::vector<ShadingPointLight> pointLights{};
+			std::vector<PointLightBounds> pointLightBounds{};
+
+			// Only the first nrBatches are this frame's
+			std::array<DrawBatch, MAX_DRAW_BATCHES> batches{};
+			uint32_t nrBatches{};
+
+			// The swap chain buffer of the same index
+			SDL_Surface* pColorBuffer{};
+			uint32_t* pColorBufferPixels{};
+
+			// This frame's depth once rasterized, see RenderSettings::isTemporalOcclusionEnabled
+			DepthBuffer occlusionHistory{ OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT };
+			bool hasOcclusionHistory{ false };
+
+			// Read by the shaders through ShadingConstants::pShadowMap while the frame rasterizes.
+			// Only created once a frame uses shadows, so frames without them don't hold a map each
+			std::unique_ptr<DepthBuffer> pShadowMap{};
+
+			JobCounter rasterCounter{};
+		};
+
+		using RasterizeFunction = void (Renderer::*)(const Frame&, uint32_t, uint32_t, const TileRect&, std::span<const ShadingPointLight>, RenderStats&);
+
+		// Culling and LOD selection on the calling thread, then every draw batch gets binned in parallel
+		void BuildFrame(const Scene& scene, Frame& frame);
+		// Runs as a job, every tile in parallel
+		void RasterizeFrame(Frame& frame);
+		void RasterizeTile(const Frame& frame, uint32_t tileIdx, RenderStats& stats);
+		// Moves the scene's point lights to view space and keeps the ones whose sphere can be on screen
+		void CullPointLights(const Scene& scene, Frame& frame);
+		// Fills lights with the frame's point lights that overlap the tile and its depth range
+		static void CullTileLights(const Frame& frame, const TileRect& tile, const DepthRange& depth, std::vector<ShadingPointLight>& lights);
+		// False when CullTileLights doesn't look at the depth range, so the forward path can skip finding it
+		static bool IsTileDepthCulled(const Frame& frame);
+		// Depth only pre-pass of the triangles binned to the tile, for the forward path which shades before its depth is final.
+		// Same raster loop as the color pass, so it leaves the exact depth the color pass ends with, and only the closest surface gets shaded
+		void RasterizeTileDepth(const Frame& frame, uint32_t tileIdx, const TileRect& tile, RenderStats& stats);
+		// Of the tile's covered pixels in m_pFramebuffer
+		DepthRange GetTileDepthRange(const TileRect& tile) const;
+		// See RenderSettings::isRasterTimingEnabled
+		bool IsRasterTimed(const Frame& frame) const;
+		// Shadows only show in the modes that shade the directional light's color, see RenderSettings::isShadowMapEnabled
+		bool IsShadowMapUsed() const;
+		// Rasterizes every instance's depth as seen from the directional light into frame.pShadowMap, rows split over the job system
+		void RenderShadowMap(const Scene& scene, Frame& frame);
+		// Waits for the oldest frame in flight and hands it to the swap chain
+		void PresentFrame();
+
+		void RenderInstance(DrawBatch& batch, const MeshInstance& instance, uint32_t lodIdx, const Frustum& frustum);
+		// Culls meshlets against the frustum and their normal cone, only the survivors get transformed
+		void RenderMeshlets(DrawBatch& batch, const MeshInstance& instance, uint32_t lodIdx, const Frustum& frustum);
+		// Culls the triangle and adds it to every tile its pixels touch
+		void BinTriangle(DrawBatch& batch, uint32_t idx0, uint32_t idx1, uint32_t idx2, const Material& material, uint32_t pixelPipelineIdx);
+		// Picks the pixel pipeline of a draw from the current settings and its material
+		uint32_t GetPixelPipelineIdx(const Material& material) const;
+		// The RasterizeTriangle instantiation of a pixel pipeline
+		static RasterizeFunction GetRasterizeFunction(uint32_t pixelPipelineIdx);
+		// Only touches the pixels inside tile, lights are the point lights culled for it.
+		// Instantiated per pixel pipeline, so the pixel loops don't test any setting or material map
+		template<RasterMode Mode, ShaderConfig Shader>
+		void RasterizeTriangle(const Frame& frame, uint32_t batchIdx, uint32_t triangleIdx, const TileRect& tile, std::span<const ShadingPointLight> lights, RenderStats& stats);
+
+		// Shades every pixel of the tile's visibility buffer exactly once, from the binned triangle it stores
+		void ShadeVisibilityTile(const Frame& frame, const TileRect& tile, std::span<const ShadingPointLight> lights, RenderStats& stats);
+		void TransformVertex(const Vertex& vertex_in, const Matrix& worldViewMatrix, Vertex_Out& vertex_out) const;
+		// View space to screen x, screen y, NDC depth, view space depth
+		Vector4 ProjectToScreen(const Vector3& viewPosition) const;
+
+		// Updates m_InstanceLods for m_VisibleInstances from their projected size
+		void SelectLods(const Scene& scene);
+		// Fills m_DrawQueue with m_VisibleInstances in the order of the current DrawSortMode
+		void QueueDraws(const Scene& scene);
+		// Removes the instances hidden behind the nearest occluders from m_VisibleInstances
+		void CullOccludedInstances(const Scene& scene, Frame& frame);
+		void RasterizeOccluder(const MeshInstance& instance, uint32_t lodIdx);
+		bool IsOccluded(const AABB& worldBounds) const;
+		// Moves the downsampled depth of an earlier frame to where it ends up with the current camera
+		void ReprojectOcclusionHistory(const Frame& historyFrame);
+		void ClearTile(const Frame& frame, const TileRect& tile);
+		// Averages the MSAA samples into the color buffer and their farthest depth into the depth buffer
+		void ResolveTile(const TileRect& tile);
+		// pixelIdx is a TiledFramebuffer index
+		void AddPixelToRGBBuffer(ColorRGB& color, size_t pixelIdx) const;
+		bool AddPixelToDepthBuffer(float depth, size_t pixelIdx) const;
 		Uint32 GetSDLRGB(const ColorRGB& color) const;
-		Rect GetBoundingBox(const std::vector<Vector3>& vertexVec) const;
 
 		SDL_Window* m_pWindow{};
 
-		SDL_Surface* m_pFrontBuffer{ nullptr };
-		SDL_Surface* m_pBackBuffer{ nullptr };
-		uint32_t* m_pBackBufferPixels{};
-		
+		SwapChain* m_pSwapChain{};
+
 		ColorRGB m_ClearColor{};
-		float* m_pDepthBufferPixels{};
+		// Only rasterization touches these, and frames rasterize one after the other.
+		// Finished tiles get copied to the frame's color buffer
+		TiledFramebuffer* m_pFramebuffer{};
+		SampleBuffer* m_pSampleBuffer{};
+		// Batch and triangle of the closest surface per pixel in the m_pFramebuffer layout,
+		// see VISIBILITY_BATCH_SHIFT and RenderSettings::isVisibilityBufferEnabled
+		std::vector<uint32_t> m_VisibilityBuffer{};
+
+		// Frame i % MAX_FRAMES_IN_FLIGHT of m_NrFramesBuilt, the last m_NrFramesInFlight of them are not presented yet
+		std::array<Frame, MAX_FRAMES_IN_FLIGHT> m_Frames{};
+		uint32_t m_NrFramesBuilt{};
+		uint32_t m_NrFramesInFlight{};
+		// Shown on screen, its depth is the newest occlusion history that is guaranteed to be done
+		const Frame* m_pPresentedFrame{};
+		// Raster counters of every tile, summed into Frame::stats
+		std::vector<RenderStats> m_TileStats{};
+		// Point lights of every tile, see RenderSettings::isLightCullingEnabled
+		std::vector<std::vector<ShadingPointLight>> m_TileLights{};
 
 		Camera m_Camera{};
 		float m_AspectRatio{};
@@ -58,8 +261,37 @@ namespace dae
 		int m_Width{};
 		int m_Height{};
 
+		RenderStats m_Stats{};
+		RenderSettings m_Settings{};
+
+		// Triangles whose pixel centers fit in a block this size get one SIMD coverage mask instead of the scanline loop
+		static constexpr int SMALL_TRIANGLE_SIZE{ 4 };
+		// Larger triangles are walked in aligned blocks, blocks fully inside skip the per pixel coverage test
+		static constexpr int RASTER_BLOCK_SIZE{ 8 };
+		// A forward tile only gets a depth pre-pass when culling against its binned depth range leaves more lights than this
+		static constexpr size_t MIN_DEPTH_PREPASS_LIGHTS{ 8 };
+		// Vertices per job of a whole mesh transform, smaller meshes stay on the calling thread
+		static constexpr uint32_t VERTEX_JOB_SIZE{ 4096 };
+
+		DepthBuffer m_OcclusionBuffer{ OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT };
+
 		// Vectors here to prevent allocation on every frame
-		std::vector<Vector3> m_TrigVertexVec{};
-		std::vector<float> m_AreaParallelVec{};
+		std::vector<uint32_t> m_VisibleInstances{};
+		// Kept between frames for the LOD hysteresis
+		std::vector<uint8_t> m_InstanceLods{};
+		DrawQueue m_DrawQueue{};
+		std::vector<Vector4> m_OccluderVertices{};
+		std::vector<std::pair<float, uint32_t>> m_Occluders{};
+
+		// The instance of the same index drawn into the shadow map, its vertices start at firstVertex in m_ShadowVertices
+		struct ShadowCaster
+		{
+			uint32_t firstVertex{};
+			uint32_t lodIdx{};
+			// Triangles per SHADOW_BAND_HEIGHT rows of the shadow map, as vertex indices
+			std::vector<std::vector<std::array<uint32_t, 3>>> bands{};
+		};
+		std::vector<ShadowCaster> m_ShadowCasters{};
+		std::vector<Vector4> m_ShadowVertices{};
 	};
 }
@@ -0,0 +1,105 @@
+#include "SampleBuffer.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+namespace
+{
+	// In 1/16 of a pixel, rotated grids so no two samples share a row or column
+	const Vector2 SAMPLES_1X[]{ { 0.f, 0.f } };
+	const Vector2 SAMPLES_2X[]{ { 4.f / 16, 4.f / 16 }, { -4.f / 16, -4.f / 16 } };
+	const Vector2 SAMPLES_4X[]{ { -2.f / 16, -6.f / 16 }, { 6.f / 16, -2.f / 16 }, { -6.f / 16, 2.f / 16 }, { 2.f / 16, 6.f / 16 } };
+	const Vector2 SAMPLES_8X[]{
+		{ 1.f / 16, -3.f / 16 }, { -1.f / 16, 3.f / 16 }, { 5.f / 16, 1.f / 16 }, { -3.f / 16, -5.f / 16 },
+		{ -5.f / 16, 5.f / 16 }, { -7.f / 16, -1.f / 16 }, { 3.f / 16, 7.f / 16 }, { 7.f / 16, -7.f / 16 }
+	};
+}
+
+SampleBuffer::SampleBuffer(int width, int height)
+	: m_NrTilesX{ (width + TILE_SIZE - 1) / TILE_SIZE }
+	, m_NrTilesY{ (height + TILE_SIZE - 1) / TILE_SIZE }
+{
+}
+
+void SampleBuffer::SetSampleCount(uint32_t sampleCount)
+{
+	m_SampleCount = sampleCount;
+	if (sampleCount <= 1)
+	{
+		m_Depth = {};
+		m_Colors = {};
+		return;
+	}
+
+	const size_t nrSamples{ static_cast<size_t>(m_NrTilesX) * m_NrTilesY * TILE_SIZE * TILE_SIZE * sampleCount };
+	m_Depth.assign(nrSamples, FLT_MAX);
+	m_Colors.assign(nrSamples, 0);
+}
+
+void SampleBuffer::Clear(const ColorRGB& color)
+{
+	std::fill(m_Depth.begin(), m_Depth.end(), FLT_MAX);
+	std::fill(m_Colors.begin(), m_Colors.end(), PackColor(color));
+}
+
+ColorRGB SampleBuffer::Resolve(int x, int y, float& farthestDepth) const
+{
+	const size_t firstSample{ GetFirstSample(x, y) };
+	const float* pDepth{ &m_Depth[firstSample] };
+	const uint32_t* pColors{ &m_Colors[firstSample] };
+
+	bool isCovered{ false };
+	bool isUniform{ true };
+	farthestDepth = 0.f;
+	for (uint32_t sampleIdx{}; sampleIdx < m_SampleCount; ++sampleIdx)
+	{
+		isCovered |= pDepth[sampleIdx] != FLT_MAX;
+		isUniform &= pColors[sampleIdx] == pColors[0];
+		farthestDepth = std::max(farthestDepth, pDepth[sampleIdx]);
+	}
+	if (!isCovered)
+		farthestDepth = FLT_MAX;
+
+	// Only pixels on an edge have differing samples
+	if (isUniform)
+		return UnpackColor(pColors[0], 1.f / 255.f);
+
+	uint32_t red{};
+	uint32_t green{};
+	uint32_t blue{};
+	for (uint32_t sampleIdx{}; sampleIdx < m_SampleCount; ++sampleIdx)
+	{
+		red += (pColors[sampleIdx] >> 16) & 0xFF;
+		green += (pColors[sampleIdx] >> 8) & 0xFF;
+		blue += pColors[sampleIdx] & 0xFF;
+	}
+
+	const float scale{ 1.f / (255.f * m_SampleCount) };
+	return { red * scale, green * scale, blue * scale };
+}
+
+std::span<const Vector2> SampleBuffer::GetSamplePositions(uint32_t sampleCount)
+{
+	switch (sampleCount)
+	{
+	case 2:
+		return SAMPLES_2X;
+	case 4:
+		return SAMPLES_4X;
+	case 8:
+		return SAMPLES_8X;
+	default:
+		return SAMPLES_1X;
+	}
+}
+
+ColorRGB SampleBuffer::UnpackColor(uint32_t packedColor, float scale)
+{
+	return { ((packedColor >> 16) & 0xFF) * scale, ((packedColor >> 8) & 0xFF) * scale, (packedColor & 0xFF) * scale };
+}
+
+uint32_t SampleBuffer::PackColor(const ColorRGB& color)
+{
+	return static_cast<uint32_t>(color.r * 255) << 16 | static_cast<uint32_t>(color.g * 255) << 8 | static_cast<uint32_t>(color.b * 255);
+}
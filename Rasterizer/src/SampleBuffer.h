@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Maths.h"
+#include "ColorRGB.h"
+
+namespace dae
+{
+	// Per sample depth and color for multisample anti-aliasing, resolved to one color per pixel at the end of the frame.
+	// Samples are stored per TILE_SIZE x TILE_SIZE pixel tile, so an 8x8 raster block stays within one contiguous range
+	class SampleBuffer final
+	{
+	public:
+		static constexpr int TILE_SIZE{ 8 };
+		static constexpr uint32_t MAX_SAMPLES{ 8 };
+
+		SampleBuffer(int width, int height);
+		~SampleBuffer() = default;
+
+		SampleBuffer(const SampleBuffer&) = delete;
+		SampleBuffer(SampleBuffer&&) noexcept = delete;
+		SampleBuffer& operator=(const SampleBuffer&) = delete;
+		SampleBuffer& operator=(SampleBuffer&&) noexcept = delete;
+
+		// 1 frees the samples, otherwise 2, 4 or 8
+		void SetSampleCount(uint32_t sampleCount);
+		uint32_t GetSampleCount() const { return m_SampleCount; }
+
+		void Clear(const ColorRGB& color);
+
+		// The pixel's GetSampleCount() samples follow each other
+		float* GetDepth(int x, int y) { return &m_Depth[GetFirstSample(x, y)]; }
+		uint32_t* GetColor(int x, int y) { return &m_Colors[GetFirstSample(x, y)]; }
+
+		// Average of the pixel's samples, farthestDepth is FLT_MAX when no sample got covered
+		ColorRGB Resolve(int x, int y, float& farthestDepth) const;
+
+		// Offsets from the pixel center, the standard D3D sample patterns
+		static std::span<const Vector2> GetSamplePositions(uint32_t sampleCount);
+
+		static uint32_t PackColor(const ColorRGB& color);
+
+	private:
+		static ColorRGB UnpackColor(uint32_t packedColor, float scale);
+
+		size_t GetFirstSample(int x, int y) const
+		{
+			const size_t tileIdx{ static_cast<size_t>(y / TILE_SIZE) * m_NrTilesX + x / TILE_SIZE };
+			const size_t pixelIdx{ tileIdx * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE };
+			return pixelIdx * m_SampleCount;
+		}
+
+		int m_NrTilesX{};
+		int m_NrTilesY{};
+		uint32_t m_SampleCount{ 1 };
+		std::vector<float> m_Depth{};
+		std::vector<uint32_t> m_Colors{};
+	};
+}
@@ -0,0 +1,91 @@
+#include "Scene.h"
+
+#include <cassert>
+
+#include "MeshCache.h"
+#include "Texture.h"
+#include "VertexPacking.h"
+
+using namespace dae;
+
+Scene::Scene() = default;
+
+Scene::~Scene() = default;
+
+const Mesh* Scene::AddMesh(const std::string& objPath, bool packVertices)
+{
+	Mesh* pMesh{ new Mesh{} };
+	if (!MeshCache::LoadOBJ(objPath, *pMesh))
+	{
+		delete pMesh;
+		return nullptr;
+	}
+
+	if (packVertices)
+		VertexPacking::PackMesh(*pMesh);
+
+	return AddMesh(pMesh);
+}
+
+const Mesh* Scene::AddMesh(Mesh* pMesh)
+{
+	pMesh->UpdateBounds();
+	m_pMeshes.emplace_back(pMesh);
+	return pMesh;
+}
+
+const Texture* Scene::AddTexture(const std::string& path)
+{
+	Texture* pTexture{ Texture::LoadFromFile(path) };
+	if (pTexture)
+		m_pTextures.emplace_back(pTexture);
+
+	return pTexture;
+}
+
+const Material* Scene::AddMaterial(const Material& material)
+{
+	Material* pMaterial{ m_pMaterials.emplace_back(std::make_unique<Material>(material)).get() };
+	pMaterial->sortId = static_cast<uint32_t>(m_pMaterials.size());
+	return pMaterial;
+}
+
+size_t Scene::AddInstance(const Mesh* pMesh, const Material* pMaterial, const Matrix& worldMatrix, const Mesh* pOccluder)
+{
+	assert(pMesh && "Instances need a mesh");
+
+	m_Instances.push_back({ pMesh, pMaterial ? pMaterial : &m_DefaultMaterial, worldMatrix, pOccluder });
+	m_IsBVHDirty = true;
+	return m_Instances.size() - 1;
+}
+
+void Scene::SetInstanceWorldMatrix(size_t instanceIdx, const Matrix& worldMatrix)
+{
+	MeshInstance& instance{ m_Instances[instanceIdx] };
+	instance.worldMatrix = worldMatrix;
+
+	if (!m_IsBVHDirty)
+		m_BVH.UpdatePrimitive(static_cast<uint32_t>(instanceIdx), instance.pMesh->bounds.Transformed(worldMatrix));
+}
+
+const BVH& Scene::GetBVH() const
+{
+	if (m_IsBVHDirty)
+	{
+		std::vector<AABB> instanceBounds{};
+		instanceBounds.reserve(m_Instances.size());
+		for (const MeshInstance& instance : m_Instances)
+			instanceBounds.push_back(instance.pMesh->bounds.Transformed(instance.worldMatrix));
+
+		m_BVH.Build(instanceBounds);
+		m_IsBVHDirty = false;
+	}
+
+	return m_BVH;
+}
+
+size_t Scene::AddPointLight(const PointLight& light)
+{
+	m_PointLights.push_back(light);
+	return m_PointLights.size() - 1;
+}
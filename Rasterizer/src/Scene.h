@@ -0,0 +1,114 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Texture;
+
+	// Lit with Lambert diffuse and Blinn-Phong specular, see RenderSettings::shadingMode.
+	// Without a diffuse map the vertex color is used, without a normal map the interpolated normal
+	struct Material
+	{
+		const Texture* pDiffuse{ nullptr };
+		// Tangent space normals
+		const Texture* pNormal{ nullptr };
+		// Specular color, there is no highlight without one
+		const Texture* pSpecular{ nullptr };
+		// Its red channel scales shininess
+		const Texture* pGloss{ nullptr };
+		// Blinn-Phong exponent
+		float shininess{ 25.f };
+		// Shades with the FastMath approximations, which are off by less than 8 bit colors can show
+		bool isFastMathAllowed{ false };
+
+		// Set by Scene::AddMaterial, draws with the same id can be grouped together. 0 is the default material
+		uint32_t sortId{};
+	};
+
+	struct DirectionalLight
+	{
+		// Normalized, from the light into the scene
+		Vector3 direction{ 0.577f, -0.577f, 0.577f };
+		ColorRGB color{ colors::White };
+		float intensity{ 7.f };
+	};
+
+	// Falls off with the squared distance and fades out completely at radius, so it only needs to be shaded inside that sphere
+	struct PointLight
+	{
+		Vector3 position{};
+		ColorRGB color{ colors::White };
+		float intensity{ 25.f };
+		float radius{ 10.f };
+	};
+
+	// One drawn copy of a mesh, instances of the same mesh share all of its vertex data
+	struct MeshInstance
+	{
+		const Mesh* pMesh{ nullptr };
+		const Material* pMaterial{ nullptr };
+		Matrix worldMatrix{};
+		// Drawn into the occlusion buffer when set, usually pMesh itself or a simplified stand-in
+		const Mesh* pOccluder{ nullptr };
+	};
+
+	class Scene final
+	{
+	public:
+		Scene();
+		~Scene();
+
+		Scene(const Scene&) = delete;
+		Scene(Scene&&) noexcept = delete;
+		Scene& operator=(const Scene&) = delete;
+		Scene& operator=(Scene&&) noexcept = delete;
+
+		// Loads through the mesh cache, returns nullptr when the file can't be loaded
+		const Mesh* AddMesh(const std::string& objPath, bool packVertices = false);
+		const Mesh* AddMesh(Mesh* pMesh);
+		// Returns nullptr when the file can't be loaded
+		const Texture* AddTexture(const std::string& path);
+		const Material* AddMaterial(const Material& material);
+
+		// Returns the instance index
+		size_t AddInstance(const Mesh* pMesh, const Material* pMaterial, const Matrix& worldMatrix, const Mesh* pOccluder = nullptr);
+		void SetInstanceWorldMatrix(size_t instanceIdx, const Matrix& worldMatrix);
+
+		const std::vector<MeshInstance>& GetInstances() const { return m_Instances; }
+		// Hierarchy over the instance world bounds, rebuilt here after instances were added
+		const BVH& GetBVH() const;
+		const Material& GetDefaultMaterial() const { return m_DefaultMaterial; }
+
+		void SetDirectionalLight(const DirectionalLight& light) { m_DirectionalLight = light; }
+		const DirectionalLight& GetDirectionalLight() const { return m_DirectionalLight; }
+		void SetAmbientColor(const ColorRGB& color) { m_AmbientColor = color; }
+		const ColorRGB& GetAmbientColor() const { return m_AmbientColor; }
+
+		// Returns the light index
+		size_t AddPointLight(const PointLight& light);
+		void SetPointLight(size_t lightIdx, const PointLight& light) { m_PointLights[lightIdx] = light; }
+		const std::vector<PointLight>& GetPointLights() const { return m_PointLights; }
+
+	private:
+		std::vector<std::unique_ptr<Mesh>> m_pMeshes{};
+		std::vector<std::unique_ptr<Texture>> m_pTextures{};
+		std::vector<std::unique_ptr<Material>> m_pMaterials{};
+		std::vector<MeshInstance> m_Instances{};
+
+		// Moving instances refits the BVH right away, adding instances rebuilds it on the next GetBVH
+		mutable BVH m_BVH{};
+		mutable bool m_IsBVHDirty{ false };
+
+		Material m_DefaultMaterial{};
+
+		DirectionalLight m_DirectionalLight{};
+		ColorRGB m_AmbientColor{ 0.025f, 0.025f, 0.025f };
+		std::vector<PointLight> m_PointLights{};
+	};
+}
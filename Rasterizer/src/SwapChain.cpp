@@ -0,0 +1,85 @@
+//External includes
+#include "SDL.h"
+#include "SDL_surface.h"
+#include <cstring>
+
+//Project includes
+#include "SwapChain.h"
+
+using namespace dae;
+
+SwapChain::SwapChain(SDL_Window* pWindow, uint32_t nrBuffers) :
+	m_pWindow(pWindow)
+{
+	const SDL_Surface* pWindowSurface{ SDL_GetWindowSurface(pWindow) };
+
+	// The renderer writes whole 32 bit pixels, other window formats keep a converting blit
+	const SDL_PixelFormat* pWindowFormat{ pWindowSurface->format };
+	for (uint32_t bufferIdx{}; bufferIdx < nrBuffers; ++bufferIdx)
+	{
+		SDL_Surface* pBuffer{ pWindowFormat->BytesPerPixel == 4
+			? SDL_CreateRGBSurfaceWithFormat(0, pWindowSurface->w, pWindowSurface->h, 32, pWindowFormat->format)
+			: SDL_CreateRGBSurface(0, pWindowSurface->w, pWindowSurface->h, 32, 0, 0, 0, 0) };
+		m_Buffers.push_back(pBuffer);
+	}
+	m_IsBufferQueued.resize(nrBuffers);
+}
+
+SwapChain::~SwapChain()
+{
+	for (SDL_Surface* pBuffer : m_Buffers)
+		SDL_FreeSurface(pBuffer);
+}
+
+void SwapChain::Present(uint32_t bufferIdx)
+{
+	m_IsBufferQueued[bufferIdx] = true;
+	m_Queue.push_back(bufferIdx);
+}
+
+void SwapChain::ShowQueued()
+{
+	for (const uint32_t bufferIdx : m_Queue)
+	{
+		CopyToWindow(m_Buffers[bufferIdx]);
+		m_IsBufferQueued[bufferIdx] = false;
+	}
+	m_Queue.clear();
+}
+
+void SwapChain::CopyToWindow(SDL_Surface* pBuffer)
+{
+	// Fetched every time, SDL replaces the window surface when the window changes
+	SDL_Surface* pFrontBuffer{ SDL_GetWindowSurface(m_pWindow) };
+	if (!pFrontBuffer)
+		return;
+
+	const bool isSameLayout{ pBuffer->format->format == pFrontBuffer->format->format && pBuffer->w == pFrontBuffer->w && pBuffer->h == pFrontBuffer->h };
+	if (!isSameLayout)
+	{
+		SDL_BlitSurface(pBuffer, nullptr, pFrontBuffer, nullptr);
+		SDL_UpdateWindowSurface(m_pWindow);
+		return;
+	}
+
+	if (SDL_MUSTLOCK(pFrontBuffer))
+		SDL_LockSurface(pFrontBuffer);
+
+	// Same format, only the row pitch can differ
+	const size_t rowSize{ static_cast<size_t>(pBuffer->w) * pBuffer->format->BytesPerPixel };
+	const uint8_t* pSource{ static_cast<const uint8_t*>(pBuffer->pixels) };
+	uint8_t* pDestination{ static_cast<uint8_t*>(pFrontBuffer->pixels) };
+	if (pBuffer->pitch == pFrontBuffer->pitch)
+	{
+		std::memcpy(pDestination, pSource, rowSize + static_cast<size_t>(pBuffer->pitch) * (pBuffer->h - 1));
+	}
+	else
+	{
+		for (int row{}; row < pBuffer->h; ++row)
+			std::memcpy(pDestination + static_cast<size_t>(row) * pFrontBuffer->pitch, pSource + static_cast<size_t>(row) * pBuffer->pitch, rowSize);
+	}
+
+	if (SDL_MUSTLOCK(pFrontBuffer))
+		SDL_UnlockSurface(pFrontBuffer);
+	SDL_UpdateWindowSurface(m_pWindow);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct SDL_Window;
+struct SDL_Surface;
+
+namespace dae
+{
+	// Back buffers in the window surface's own pixel format, so showing one is a plain memcpy.
+	// The job system renders into one buffer while the main thread shows an earlier one, SDL video calls stay on the main thread
+	class SwapChain final
+	{
+	public:
+		SwapChain(SDL_Window* pWindow, uint32_t nrBuffers);
+		~SwapChain();
+
+		SwapChain(const SwapChain&) = delete;
+		SwapChain(SwapChain&&) noexcept = delete;
+		SwapChain& operator=(const SwapChain&) = delete;
+		SwapChain& operator=(SwapChain&&) noexcept = delete;
+
+		SDL_Surface* GetBuffer(uint32_t bufferIdx) const { return m_Buffers[bufferIdx]; }
+
+		// Queues a finished buffer for the window, it can't be drawn to again until ShowQueued copied it
+		void Present(uint32_t bufferIdx);
+		bool IsQueued(uint32_t bufferIdx) const { return m_IsBufferQueued[bufferIdx]; }
+		// Main thread only: copies the queued buffers to the window in the order they were queued and releases them
+		void ShowQueued();
+
+	private:
+		void CopyToWindow(SDL_Surface* pBuffer);
+
+		SDL_Window* m_pWindow{};
+		std::vector<SDL_Surface*> m_Buffers{};
+
+		std::deque<uint32_t> m_Queue{};
+		std::vector<uint8_t> m_IsBufferQueued{};
+	};
+}
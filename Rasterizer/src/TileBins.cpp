@@ -0,0 +1,47 @@
+#include "TileBins.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+void TileBins::Resize(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_NrTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int nrTilesY{ (height + TILE_SIZE - 1) / TILE_SIZE };
+	m_Tiles.resize(static_cast<size_t>(m_NrTilesX) * nrTilesY);
+	m_DepthRanges.resize(m_Tiles.size());
+}
+
+void TileBins::Clear()
+{
+	for (std::vector<uint32_t>& tile : m_Tiles)
+		tile.clear();
+	std::fill(m_DepthRanges.begin(), m_DepthRanges.end(), DepthRange{});
+}
+
+void TileBins::Add(uint32_t triangleIdx, const TileRect& pixels, const DepthRange& depth)
+{
+	const int firstTileX{ pixels.minX / TILE_SIZE };
+	const int firstTileY{ pixels.minY / TILE_SIZE };
+	const int lastTileX{ (pixels.maxX - 1) / TILE_SIZE };
+	const int lastTileY{ (pixels.maxY - 1) / TILE_SIZE };
+
+	for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+	{
+		for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+		{
+			const int tileIdx{ tileX + tileY * m_NrTilesX };
+			m_Tiles[tileIdx].push_back(triangleIdx);
+			m_DepthRanges[tileIdx].Add(depth);
+		}
+	}
+}
+
+TileRect TileBins::GetTileRect(uint32_t tileIdx) const
+{
+	const int minX{ static_cast<int>(tileIdx % m_NrTilesX) * TILE_SIZE };
+	const int minY{ static_cast<int>(tileIdx / m_NrTilesX) * TILE_SIZE };
+	return { minX, minY, std::min(minX + TILE_SIZE, m_Width), std::min(minY + TILE_SIZE, m_Height) };
+}
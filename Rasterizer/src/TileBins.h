@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace dae
+{
+	// Pixels [minX, maxX) x [minY, maxY)
+	struct TileRect
+	{
+		int minX{};
+		int minY{};
+		int maxX{};
+		int maxY{};
+
+		bool IsEmpty() const { return minX >= maxX || minY >= maxY; }
+	};
+
+	// NDC depth range, empty while min is above max
+	struct DepthRange
+	{
+		float min{ 1.f };
+		float max{ 0.f };
+
+		bool IsEmpty() const { return min > max; }
+		void Add(const DepthRange& other)
+		{
+			min = std::min(min, other.min);
+			max = std::max(max, other.max);
+		}
+	};
+
+	// The screen split in TILE_SIZE x TILE_SIZE tiles, each listing the triangles that touch it in the order they were added.
+	// Every tile can then be rasterized on its own, with the same result as drawing the triangles one after the other
+	class TileBins final
+	{
+	public:
+		static constexpr int TILE_SIZE{ 64 };
+
+		TileBins() = default;
+		~TileBins() = default;
+
+		TileBins(const TileBins&) = delete;
+		TileBins(TileBins&&) noexcept = delete;
+		TileBins& operator=(const TileBins&) = delete;
+		TileBins& operator=(TileBins&&) noexcept = delete;
+
+		void Resize(int width, int height);
+		// Empties every tile but keeps their memory
+		void Clear();
+
+		// Adds triangleIdx to every tile overlapping pixels, widening their depth range to the triangle's
+		void Add(uint32_t triangleIdx, const TileRect& pixels, const DepthRange& depth);
+
+		uint32_t GetNrTiles() const { return static_cast<uint32_t>(m_Tiles.size()); }
+		// Clamped to the screen
+		TileRect GetTileRect(uint32_t tileIdx) const;
+		std::span<const uint32_t> GetTriangles(uint32_t tileIdx) const { return m_Tiles[tileIdx]; }
+		// Spans every triangle of the tile, so the surfaces drawn there are somewhere inside it
+		const DepthRange& GetDepthRange(uint32_t tileIdx) const { return m_DepthRanges[tileIdx]; }
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_NrTilesX{};
+		std::vector<std::vector<uint32_t>> m_Tiles{};
+		std::vector<DepthRange> m_DepthRanges{};
+	};
+}
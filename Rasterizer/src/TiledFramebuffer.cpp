@@ -0,0 +1,43 @@
+#include "TiledFramebuffer.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+using namespace dae;
+
+TiledFramebuffer::TiledFramebuffer(int width, int height) :
+	m_Width(width),
+	m_Height(height),
+	m_NrTilesX((width + TILE_SIZE - 1) / TILE_SIZE)
+{
+	const int nrTilesY{ (height + TILE_SIZE - 1) / TILE_SIZE };
+	const size_t nrPixels{ static_cast<size_t>(m_NrTilesX) * nrTilesY * TILE_PIXELS };
+	m_Depth.resize(nrPixels);
+	m_Colors.resize(nrPixels);
+}
+
+void TiledFramebuffer::ClearTile(const TileRect& tile, uint32_t color, float depth)
+{
+	// The whole block, the part past the screen edge never gets drawn or read
+	const size_t firstPixel{ GetPixelIdx(tile.minX, tile.minY) };
+	std::fill_n(m_Depth.begin() + firstPixel, TILE_PIXELS, depth);
+	std::fill_n(m_Colors.begin() + firstPixel, TILE_PIXELS, color);
+}
+
+void TiledFramebuffer::DetileColors(const TileRect& tile, uint32_t* pPixels, int pitch) const
+{
+	const int width{ tile.maxX - tile.minX };
+	const uint32_t* pTileRow{ &m_Colors[GetPixelIdx(tile.minX, tile.minY)] };
+
+	for (int py{ tile.minY }; py < tile.maxY; ++py, pTileRow += TILE_SIZE)
+	{
+		uint32_t* pRow{ pPixels + static_cast<size_t>(py) * pitch + tile.minX };
+
+		// Tile rows are 16 byte aligned, the destination rows don't have to be
+		int px{};
+		for (; px + 4 <= width; px += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pRow + px), _mm_load_si128(reinterpret_cast<const __m128i*>(pTileRow + px)));
+		for (; px < width; ++px)
+			pRow[px] = pTileRow[px];
+	}
+}
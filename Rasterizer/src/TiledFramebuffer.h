@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "TileBins.h"
+
+namespace dae
+{
+	// Color and depth stored tile after tile, every TileBins tile is one contiguous block of TILE_SIZE x TILE_SIZE pixels.
+	// A tile worker only touches its own 16 KB of color and 16 KB of depth, which stay in cache while it rasterizes
+	class TiledFramebuffer final
+	{
+	public:
+		static constexpr int TILE_SIZE{ TileBins::TILE_SIZE };
+		static constexpr int TILE_PIXELS{ TILE_SIZE * TILE_SIZE };
+
+		// Tiles overhanging the right and bottom edge are stored whole
+		TiledFramebuffer(int width, int height);
+		~TiledFramebuffer() = default;
+
+		TiledFramebuffer(const TiledFramebuffer&) = delete;
+		TiledFramebuffer(TiledFramebuffer&&) noexcept = delete;
+		TiledFramebuffer& operator=(const TiledFramebuffer&) = delete;
+		TiledFramebuffer& operator=(TiledFramebuffer&&) noexcept = delete;
+
+		size_t GetPixelIdx(int x, int y) const
+		{
+			const size_t tileIdx{ static_cast<size_t>(y / TILE_SIZE) * m_NrTilesX + x / TILE_SIZE };
+			return tileIdx * TILE_PIXELS + (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+		}
+		// Also counts the pixels of the overhanging tiles
+		size_t GetNrPixels() const { return m_Depth.size(); }
+
+		float* GetDepth() { return m_Depth.data(); }
+		const float* GetDepth() const { return m_Depth.data(); }
+		uint32_t* GetColors() { return m_Colors.data(); }
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+		void ClearTile(const TileRect& tile, uint32_t color, float depth);
+		// Copies the tile's colors to row major pixels, pitch in pixels
+		void DetileColors(const TileRect& tile, uint32_t* pPixels, int pitch) const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_NrTilesX{};
+		std::vector<float> m_Depth{};
+		std::vector<uint32_t> m_Colors{};
+	};
+}
@@ -5,11 +5,16 @@
 #undef main
 
 //Standard includes
+#include <array>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <vector>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
+#include "Scene.h"
 
 using namespace dae;
 
@@ -19,17 +24,99 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
-int main(int argc, char* args[])
+void ToggleSetting(Renderer* pRenderer, bool RenderSettings::* pSetting, const char* pName)
+{
+	RenderSettings settings{ pRenderer->GetSettings() };
+	settings.*pSetting = !(settings.*pSetting);
+	pRenderer->SetSettings(settings);
+
+	std::cout << pName << (settings.*pSetting ? ": ON" : ": OFF") << std::endl;
+}
+
+void CycleDrawSortMode(Renderer* pRenderer)
+{
+	RenderSettings settings{ pRenderer->GetSettings() };
+	switch (settings.drawSortMode)
+	{
+	case DrawSortMode::Submission:
+		settings.drawSortMode = DrawSortMode::FrontToBack;
+		std::cout << "Draw order: front to back" << std::endl;
+		break;
+	case DrawSortMode::FrontToBack:
+		settings.drawSortMode = DrawSortMode::MaterialFrontToBack;
+		std::cout << "Draw order: by material, then front to back" << std::endl;
+		break;
+	case DrawSortMode::MaterialFrontToBack:
+		settings.drawSortMode = DrawSortMode::Submission;
+		std::cout << "Draw order: submission" << std::endl;
+		break;
+	}
+	pRenderer->SetSettings(settings);
+}
+
+void CycleMsaa(Renderer* pRenderer)
+{
+	RenderSettings settings{ pRenderer->GetSettings() };
+	settings.msaaSampleCount = settings.msaaSampleCount >= 8 ? 1 : settings.msaaSampleCount * 2;
+	pRenderer->SetSettings(settings);
+	std::cout << "MSAA: " << pRenderer->GetSettings().msaaSampleCount << "x" << std::endl;
+}
+
+void CycleFrameLatency(Renderer* pRenderer)
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	RenderSettings settings{ pRenderer->GetSettings() };
+	settings.frameLatency = (settings.frameLatency + 1) % (RenderSettings::MAX_FRAME_LATENCY + 1);
+	pRenderer->SetSettings(settings);
+	std::cout << "Frame latency: " << settings.frameLatency << std::endl;
+}
 
+void CycleShadingMode(Renderer* pRenderer)
+{
+	RenderSettings settings{ pRenderer->GetSettings() };
+	switch (settings.shadingMode)
+	{
+	case ShadingMode::Unlit:
+		settings.shadingMode = ShadingMode::ObservedArea;
+		std::cout << "Shading: observed area" << std::endl;
+		break;
+	case ShadingMode::ObservedArea:
+		settings.shadingMode = ShadingMode::Diffuse;
+		std::cout << "Shading: diffuse" << std::endl;
+		break;
+	case ShadingMode::Diffuse:
+		settings.shadingMode = ShadingMode::Specular;
+		std::cout << "Shading: specular" << std::endl;
+		break;
+	case ShadingMode::Specular:
+		settings.shadingMode = ShadingMode::Combined;
+		std::cout << "Shading: combined" << std::endl;
+		break;
+	case ShadingMode::Combined:
+		settings.shadingMode = ShadingMode::Unlit;
+		std::cout << "Shading: unlit" << std::endl;
+		break;
+	}
+	pRenderer->SetSettings(settings);
+}
+
+// The positive number at argIdx, or defaultValue when it is missing or invalid
+int GetArgument(int argc, char* args[], int argIdx, int defaultValue)
+{
+	if (argIdx >= argc)
+		return defaultValue;
+
+	const int value{ std::atoi(args[argIdx]) };
+	return value > 0 ? value : defaultValue;
+}
+
+// Rasterizer [width height [vehicles per side [lights per side]]], so benchmarks can name the scene they measured
+int main(int argc, char* args[])
+{
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
+	const int width{ GetArgument(argc, args, 1, 640) };
+	const int height{ GetArgument(argc, args, 2, 480) };
 
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"Rasterizer - W6 DEMO",
@@ -44,6 +131,61 @@ int main(int argc, char* args[])
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
 
+	//Build scene, every vehicle instance shares the same mesh
+	const auto pScene = new Scene();
+	const Mesh* pVehicleMesh{ pScene->AddMesh("Resources/vehicle.obj") };
+	if (!pVehicleMesh)
+	{
+		std::cout << "Failed to load Resources/vehicle.obj" << std::endl;
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+		ShutDown(pWindow);
+		return 1;
+	}
+
+	Material vehicleMaterial{};
+	vehicleMaterial.pDiffuse = pScene->AddTexture("Resources/vehicle_diffuse.png");
+	vehicleMaterial.pNormal = pScene->AddTexture("Resources/vehicle_normal.png");
+	vehicleMaterial.pSpecular = pScene->AddTexture("Resources/vehicle_specular.png");
+	vehicleMaterial.pGloss = pScene->AddTexture("Resources/vehicle_gloss.png");
+	vehicleMaterial.isFastMathAllowed = true;
+	const Material* pVehicleMaterial{ pScene->AddMaterial(vehicleMaterial) };
+
+	const int nrVehiclesPerSide{ GetArgument(argc, args, 3, 3) };
+	const float vehicleSpacing{ 45.f };
+	for (int row{}; row < nrVehiclesPerSide; ++row)
+	{
+		for (int column{}; column < nrVehiclesPerSide; ++column)
+		{
+			const Vector3 position{ (column - nrVehiclesPerSide / 2) * vehicleSpacing, 0.f, row * vehicleSpacing };
+			pScene->AddInstance(pVehicleMesh, pVehicleMaterial, Matrix::CreateTranslation(position), pVehicleMesh);
+		}
+	}
+
+	// A grid of small point lights over the vehicles, each circling its own spot
+	const int nrLightsPerSide{ GetArgument(argc, args, 4, 16) };
+	const float lightSpacing{ 8.f };
+	const float lightOrbitRadius{ 3.f };
+	const std::array<ColorRGB, 4> lightColors{ ColorRGB{ 1.f, 0.4f, 0.2f }, ColorRGB{ 0.2f, 0.6f, 1.f }, ColorRGB{ 0.4f, 1.f, 0.3f }, ColorRGB{ 1.f, 0.9f, 0.6f } };
+	std::vector<Vector3> lightCenters{};
+	for (int row{}; row < nrLightsPerSide; ++row)
+	{
+		for (int column{}; column < nrLightsPerSide; ++column)
+		{
+			PointLight light{};
+			light.position = { (column - (nrLightsPerSide - 1) * 0.5f) * lightSpacing, 5.f + (row + column) % 3 * 2.5f, row * lightSpacing - 15.f };
+			light.color = lightColors[(row * 3 + column) % lightColors.size()];
+			light.radius = 12.f;
+			pScene->AddPointLight(light);
+			lightCenters.push_back(light.position);
+		}
+	}
+
+	// Names the scene the timings below belong to, see the command line above main
+	std::cout << "Scene: " << width << "x" << height << ", " << nrVehiclesPerSide * nrVehiclesPerSide << " vehicles, "
+		<< lightCenters.size() << " point lights" << std::endl;
+
 	//Start loop
 	pTimer->Start();
 
@@ -67,15 +209,46 @@ int main(int argc, char* args[])
 			case SDL_KEYUP:
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
+				else if (e.key.keysym.scancode == SDL_SCANCODE_O)
+					ToggleSetting(pRenderer, &RenderSettings::isOcclusionCullingEnabled, "Occlusion culling");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_T)
+					ToggleSetting(pRenderer, &RenderSettings::isTemporalOcclusionEnabled, "Temporal occlusion");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_R)
+					CycleDrawSortMode(pRenderer);
+				else if (e.key.keysym.scancode == SDL_SCANCODE_L)
+					ToggleSetting(pRenderer, &RenderSettings::isLodEnabled, "LODs");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_M)
+					CycleMsaa(pRenderer);
+				else if (e.key.keysym.scancode == SDL_SCANCODE_V)
+					ToggleSetting(pRenderer, &RenderSettings::isVisibilityBufferEnabled, "Visibility buffer");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_P)
+					CycleFrameLatency(pRenderer);
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					CycleShadingMode(pRenderer);
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F6)
+					ToggleSetting(pRenderer, &RenderSettings::isNormalMapEnabled, "Normal map");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					ToggleSetting(pRenderer, &RenderSettings::isLightCullingEnabled, "Light culling");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					ToggleSetting(pRenderer, &RenderSettings::isShadowMapEnabled, "Shadows");
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					ToggleSetting(pRenderer, &RenderSettings::isRasterTimingEnabled, "Raster timing");
 				break;
 			}
 		}
 
 		//--------- Update ---------
 		pRenderer->Update(pTimer);
+		for (size_t lightIdx{}; lightIdx < lightCenters.size(); ++lightIdx)
+		{
+			PointLight light{ pScene->GetPointLights()[lightIdx] };
+			const float angle{ pTimer->GetTotal() + lightIdx * 0.7f };
+			light.position = lightCenters[lightIdx] + Vector3{ std::cos(angle), 0.f, std::sin(angle) } * lightOrbitRadius;
+			pScene->SetPointLight(lightIdx, light);
+		}
 
 		//--------- Render ---------
-		pRenderer->Render();
+		pRenderer->Render(*pScene);
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -83,7 +256,7 @@ int main(int argc, char* args[])
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "dFPS: " << pTimer->GetdFPS() << " | " << pRenderer->GetStats() << std::endl;
 		}
 
 		//Save screenshot after full render
@@ -99,6 +272,7 @@ int main(int argc, char* args[])
 	pTimer->Stop();
 
 	//Shutdown "framework"
+	delete pScene;
 	delete pRenderer;
 	delete pTimer;
 
@@ -1,12 +1,353 @@
 #include "gtest/gtest.h"
 #include "Maths.h"
+#include "DataTypes.h"
+#include "DrawQueue.h"
+#include "FastMath.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TangentSpace.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <utility>
 
 
 namespace dae
 {
+	// gridSize x gridSize quads in the XY plane, every face normal points along +Z
+	static void CreateFlatGrid(uint32_t gridSize, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		for (uint32_t y{}; y <= gridSize; ++y)
+			for (uint32_t x{}; x <= gridSize; ++x)
+				vertices.push_back({ Vector3{ float(x), float(y), 0.f } });
+		for (uint32_t y{}; y < gridSize; ++y)
+		{
+			for (uint32_t x{}; x < gridSize; ++x)
+			{
+				const uint32_t corner{ y * (gridSize + 1) + x };
+				indices.insert(indices.end(), { corner, corner + 1, corner + gridSize + 2, corner, corner + gridSize + 2, corner + gridSize + 1 });
+			}
+		}
+	}
+
 	TEST(TestCaseName, TestName) {
 		EXPECT_EQ(Vector3::Cross(Vector3::UnitX, Vector3::UnitY), Vector3::UnitZ);
 		EXPECT_TRUE(true);
 	}
 
+	TEST(VertexPacking, HalfFloatRoundTrip) {
+		for (const float value : { 0.f, 1.f, -2.5f, 0.5f, 65504.f })
+			EXPECT_EQ(VertexPacking::HalfToFloat(VertexPacking::FloatToHalf(value)), value);
+		EXPECT_NEAR(VertexPacking::HalfToFloat(VertexPacking::FloatToHalf(0.333f)), 0.333f, 1e-3f);
+	}
+
+	TEST(VertexPacking, OctahedralRoundTrip) {
+		const Vector3 directions[]{ Vector3::UnitX, -Vector3::UnitZ, Vector3{ 0.577f, -0.577f, -0.577f }.Normalized() };
+		for (const Vector3& direction : directions)
+		{
+			const Vector3 decoded{ VertexPacking::DecodeOctahedral(VertexPacking::EncodeOctahedral(direction)) };
+			EXPECT_NEAR((decoded - direction).Magnitude(), 0.f, 1e-3f);
+		}
+	}
+
+	TEST(MeshletBuilder, FlatGrid) {
+		constexpr uint32_t gridSize{ 20 };
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateFlatGrid(gridSize, vertices, indices);
+
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{};
+		std::vector<uint8_t> meshletTriangles{};
+		MeshletBuilder::Build(vertices, indices, meshlets, meshletVertices, meshletTriangles);
+
+		uint32_t nrTriangles{};
+		for (const Meshlet& meshlet : meshlets)
+		{
+			EXPECT_LE(meshlet.vertexCount, MeshletBuilder::MAX_VERTICES);
+			EXPECT_LE(meshlet.triangleCount, MeshletBuilder::MAX_TRIANGLES);
+			nrTriangles += meshlet.triangleCount;
+
+			EXPECT_TRUE(MeshletBuilder::IsBackFacing(meshlet.coneApex, meshlet.coneAxis, meshlet.coneCutoff, meshlet.center - Vector3::UnitZ * 10.f));
+			EXPECT_FALSE(MeshletBuilder::IsBackFacing(meshlet.coneApex, meshlet.coneAxis, meshlet.coneCutoff, meshlet.center + Vector3::UnitZ * 10.f));
+		}
+		EXPECT_EQ(nrTriangles, gridSize * gridSize * 2);
+	}
+
+	TEST(MeshSimplifier, FlatGrid) {
+		// A flat grid can lose almost all of its triangles without moving the surface
+		constexpr uint32_t gridSize{ 20 };
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateFlatGrid(gridSize, vertices, indices);
+
+		float error{};
+		const std::vector<uint32_t> simplified{ MeshSimplifier::Simplify(vertices, indices, indices.size() / 4, 0.01f, error) };
+		EXPECT_LE(simplified.size(), indices.size() / 4);
+		EXPECT_EQ(simplified.size() % 3, 0);
+		EXPECT_LT(error, 0.01f);
+
+		// Same area, so no triangle got flipped and the border stayed in place
+		float area{};
+		for (size_t idx{}; idx < simplified.size(); idx += 3)
+		{
+			ASSERT_LT(simplified[idx + 2], vertices.size());
+			const Vector3& p0{ vertices[simplified[idx]].position };
+			area += Vector3::Cross(vertices[simplified[idx + 1]].position - p0, vertices[simplified[idx + 2]].position - p0).z * 0.5f;
+		}
+		EXPECT_NEAR(area, float(gridSize * gridSize), 0.001f);
+	}
+
+	TEST(MeshOptimizer, ShuffledGrid) {
+		constexpr uint32_t gridSize{ 20 };
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateFlatGrid(gridSize, vertices, indices);
+
+		// Triangles in random order, so the optimizer has cache misses to remove
+		std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+		std::memcpy(triangles.data(), indices.data(), indices.size() * sizeof(uint32_t));
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ 7 });
+		std::memcpy(indices.data(), triangles.data(), indices.size() * sizeof(uint32_t));
+
+		const MeshOptimizer::OptimizationReport report{ MeshOptimizer::Optimize(vertices, indices) };
+		EXPECT_LE(report.after.acmr, report.before.acmr);
+		EXPECT_EQ(report.after.acmr, MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()).acmr);
+
+		// The vertices got renumbered, their grid position still tells which one they are.
+		// Every triangle starts at its smallest vertex so the winding has to stay the same
+		const auto getCanonicalTriangles = [](const std::vector<Vertex>& meshVertices, const std::vector<uint32_t>& meshIndices)
+		{
+			std::vector<std::array<uint32_t, 3>> canonical{};
+			for (size_t idx{}; idx < meshIndices.size(); idx += 3)
+			{
+				std::array<uint32_t, 3> corners{};
+				for (size_t corner{}; corner < 3; ++corner)
+				{
+					const Vector3& position{ meshVertices[meshIndices[idx + corner]].position };
+					corners[corner] = static_cast<uint32_t>(position.y) * (gridSize + 1) + static_cast<uint32_t>(position.x);
+				}
+				std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+				canonical.push_back(corners);
+			}
+			std::sort(canonical.begin(), canonical.end());
+			return canonical;
+		};
+		std::vector<Vertex> gridVertices{};
+		std::vector<uint32_t> gridIndices{};
+		CreateFlatGrid(gridSize, gridVertices, gridIndices);
+		EXPECT_EQ(getCanonicalTriangles(vertices, indices), getCanonicalTriangles(gridVertices, gridIndices));
+	}
+
+	TEST(MeshCache, WriteMapRoundTrip) {
+		Mesh mesh{};
+		CreateFlatGrid(8, mesh.vertices, mesh.indices);
+		MeshletBuilder::Build(mesh.vertices, mesh.indices, mesh.meshlets, mesh.meshletVertices, mesh.meshletTriangles);
+		mesh.lods.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()), 0, static_cast<uint32_t>(mesh.meshlets.size()), 0.f });
+
+		constexpr uint64_t sourceHash{ 0x1234 };
+		const std::string cachePath{ (std::filesystem::temp_directory_path() / "MeshCache_WriteMapRoundTrip.mesh").string() };
+		ASSERT_TRUE(MeshCache::Write(cachePath, mesh, sourceHash, MeshCache::FLAG_FLIP_AXIS_AND_WINDING));
+
+		const auto isSameBytes = []<typename T>(std::span<const T> mapped, const std::vector<T>& owned)
+		{
+			return mapped.size() == owned.size() && std::memcmp(mapped.data(), owned.data(), owned.size() * sizeof(T)) == 0;
+		};
+		{
+			Mesh mapped{};
+			ASSERT_TRUE(MeshCache::Map(cachePath, mapped, sourceHash, MeshCache::FLAG_FLIP_AXIS_AND_WINDING));
+			EXPECT_TRUE(isSameBytes(mapped.GetVertices(), mesh.vertices));
+			EXPECT_TRUE(isSameBytes(mapped.GetIndices(), mesh.indices));
+			EXPECT_TRUE(isSameBytes(mapped.GetMeshlets(), mesh.meshlets));
+			EXPECT_TRUE(isSameBytes(mapped.GetMeshletVertices(), mesh.meshletVertices));
+			EXPECT_TRUE(isSameBytes(mapped.GetMeshletTriangles(), mesh.meshletTriangles));
+			EXPECT_TRUE(isSameBytes(mapped.GetLods(), mesh.lods));
+
+			// A cache of another source or import setting is stale
+			Mesh stale{};
+			EXPECT_FALSE(MeshCache::Map(cachePath, stale, sourceHash + 1, MeshCache::FLAG_FLIP_AXIS_AND_WINDING));
+			EXPECT_FALSE(MeshCache::Map(cachePath, stale, sourceHash, 0));
+		}
+		// Only once nothing maps it anymore
+		std::filesystem::remove(cachePath);
+	}
+
+	TEST(TangentSpace, TiltedQuad) {
+		// A 2x2 quad grid with uvs along x and y, its normals lean away from the center like a curved surface
+		constexpr uint32_t gridSize{ 2 };
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateFlatGrid(gridSize, vertices, indices);
+		for (Vertex& vertex : vertices)
+		{
+			vertex.uv = { vertex.position.x / gridSize, vertex.position.y / gridSize };
+			vertex.normal = Vector3{ 0.3f * (vertex.position.x - 1.f), 0.2f * (vertex.position.y - 1.f), 1.f }.Normalized();
+		}
+
+		TangentSpace::GenerateTangents(vertices, indices);
+		for (const Vertex& vertex : vertices)
+		{
+			EXPECT_NEAR(vertex.tangent.Magnitude(), 1.f, 1e-5f);
+			EXPECT_NEAR(Vector3::Dot(vertex.tangent, vertex.normal), 0.f, 1e-5f);
+			// u grows along +x
+			EXPECT_GT(vertex.tangent.x, 0.9f);
+		}
+	}
+
+	TEST(DrawQueue, MatchesStableSort) {
+		struct Draw
+		{
+			uint32_t instanceIdx{};
+			uint32_t group{};
+			uint32_t depthStep{};
+		};
+
+		// Groups past 255 wrap, few depth steps give many equal keys whose submission order has to stay
+		std::mt19937 random{ 11 };
+		std::uniform_int_distribution<uint32_t> groupDistribution{ 0, 299 };
+		std::uniform_int_distribution<uint32_t> depthDistribution{ 0, 63 };
+		std::vector<Draw> draws(5000);
+		DrawQueue queue{};
+		for (uint32_t drawIdx{}; drawIdx < draws.size(); ++drawIdx)
+		{
+			draws[drawIdx] = { drawIdx, groupDistribution(random), depthDistribution(random) };
+			queue.Submit(drawIdx, draws[drawIdx].group, draws[drawIdx].depthStep / 64.f);
+		}
+		queue.Sort();
+
+		std::stable_sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b)
+		{
+			return std::pair{ a.group & 0xff, a.depthStep } < std::pair{ b.group & 0xff, b.depthStep };
+		});
+		ASSERT_EQ(queue.GetSize(), draws.size());
+		for (size_t drawIdx{}; drawIdx < draws.size(); ++drawIdx)
+			EXPECT_EQ(queue[drawIdx], draws[drawIdx].instanceIdx);
+	}
+
+	TEST(JobSystem, ParallelForAndDependencies) {
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+
+		// Every element written exactly once, also from a nested ParallelFor that has to help while waiting
+		std::vector<uint32_t> values(10000);
+		jobSystem.ParallelFor(10, 1, [&](uint32_t outerBegin, uint32_t)
+		{
+			jobSystem.ParallelFor(1000, 64, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t idx{ begin }; idx < end; ++idx)
+					++values[outerBegin * 1000 + idx];
+			});
+		});
+		EXPECT_EQ(std::count(values.begin(), values.end(), 1u), 10000);
+
+		// The dependent job only starts after all of the first ones finished
+		std::atomic<uint32_t> nrFinished{};
+		uint32_t nrFinishedBeforeDependent{};
+		JobCounter first{};
+		JobCounter second{};
+		for (int idx{}; idx < 64; ++idx)
+			jobSystem.Run(first, [&]() { ++nrFinished; });
+		jobSystem.Run(second, [&]() { nrFinishedBeforeDependent = nrFinished; }, first);
+		jobSystem.Wait(second);
+		EXPECT_TRUE(first.IsDone());
+		EXPECT_EQ(nrFinishedBeforeDependent, 64u);
+	}
+
+	TEST(FastMath, ErrorBounds) {
+		const auto getLane = [](__m128 value) { return _mm_cvtss_f32(value); };
+
+		// A spread of normal floats, every bit pattern step apart
+		double rcpError{};
+		double rsqrtError{};
+		double log2Error{};
+		for (uint32_t bits{ 0x00800000 }; bits < 0x7E000000; bits += 4099)
+		{
+			float a{};
+			std::memcpy(&a, &bits, sizeof(a));
+			const double exact{ a };
+			rcpError = std::max(rcpError, std::abs(getLane(FastMath::Rcp(_mm_set1_ps(a))) * exact - 1.0));
+			rsqrtError = std::max(rsqrtError, std::abs(getLane(FastMath::Rsqrt(_mm_set1_ps(a))) * std::sqrt(exact) - 1.0));
+			log2Error = std::max(log2Error, std::abs(getLane(FastMath::Log2(_mm_set1_ps(a))) - std::log2(exact)) / (1.0 + std::abs(std::log2(exact))));
+		}
+		EXPECT_LT(rcpError, 3e-7);
+		EXPECT_LT(rsqrtError, 4e-7);
+		EXPECT_LT(log2Error, 1.5e-7);
+
+		double exp2Error{};
+		for (float x{ -126.f }; x < 128.f; x += 0.0137f)
+			exp2Error = std::max(exp2Error, std::abs(getLane(FastMath::Exp2(_mm_set1_ps(x))) / std::exp2(double(x)) - 1.0));
+		EXPECT_LT(exp2Error, 3e-7);
+
+		// Specular highlights, cosines to the power of glossy exponents
+		double powError{};
+		for (float base{ 1e-3f }; base <= 1.f; base *= 1.01f)
+		{
+			for (const float exponent : { 0.5f, 1.f, 7.5f, 25.f, 100.f })
+			{
+				const double exact{ std::pow(double(base), double(exponent)) };
+				if (exact < FLT_MIN)
+					continue;
+				const double error{ std::abs(getLane(FastMath::Pow(_mm_set1_ps(base), _mm_set1_ps(exponent))) / exact - 1.0) };
+				powError = std::max(powError, error / (1.0 + std::abs(exponent * std::log2(double(base)))));
+			}
+		}
+		EXPECT_LT(powError, 3e-7);
+
+		EXPECT_EQ(getLane(FastMath::Pow(_mm_set1_ps(0.f), _mm_set1_ps(3.f))), 0.f);
+		EXPECT_EQ(getLane(FastMath::Pow(_mm_set1_ps(0.f), _mm_set1_ps(0.f))), 1.f);
+		EXPECT_EQ(getLane(FastMath::Pow(_mm_set1_ps(1.f), _mm_set1_ps(25.f))), 1.f);
+	}
+
+	// Prints how much faster every approximation is than libm on this machine, run it with --gtest_also_run_disabled_tests
+	TEST(FastMath, DISABLED_Benchmark) {
+		constexpr size_t nrValues{ 1 << 18 };
+		std::vector<float> bases(nrValues);
+		std::vector<float> exponents(nrValues);
+		std::vector<float> results(nrValues);
+		for (size_t idx{}; idx < nrValues; ++idx)
+		{
+			bases[idx] = 0.001f + float(idx % 1000) / 1000.f;
+			exponents[idx] = 1.f + float(idx % 64);
+		}
+
+		const auto measure = [&](auto function)
+		{
+			double bestTime{ DBL_MAX };
+			for (int run{}; run < 5; ++run)
+			{
+				const auto start{ std::chrono::steady_clock::now() };
+				function();
+				bestTime = std::min(bestTime, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+			}
+			return bestTime / nrValues;
+		};
+		const auto compare = [&](const char* pName, auto fast, auto exact)
+		{
+			const double fastTime{ measure([&]()
+			{
+				for (size_t idx{}; idx < nrValues; idx += 4)
+					_mm_storeu_ps(&results[idx], fast(_mm_loadu_ps(&bases[idx]), _mm_loadu_ps(&exponents[idx])));
+			}) };
+			const double exactTime{ measure([&]()
+			{
+				for (size_t idx{}; idx < nrValues; ++idx)
+					results[idx] = exact(bases[idx], exponents[idx]);
+			}) };
+			std::cout << pName << ": " << fastTime << " ns, libm " << exactTime << " ns per value" << std::endl;
+		};
+
+		compare("Rcp", [](__m128 a, __m128) { return FastMath::Rcp(a); }, [](float a, float) { return 1.f / a; });
+		compare("Rsqrt", [](__m128 a, __m128) { return FastMath::Rsqrt(a); }, [](float a, float) { return 1.f / std::sqrt(a); });
+		compare("Exp2", [](__m128 a, __m128 b) { return FastMath::Exp2(_mm_mul_ps(a, b)); }, [](float a, float b) { return std::exp2(a * b); });
+		compare("Log2", [](__m128 a, __m128) { return FastMath::Log2(a); }, [](float a, float) { return std::log2(a); });
+		compare("Pow", [](__m128 a, __m128 b) { return FastMath::Pow(a, b); }, [](float a, float b) { return std::pow(a, b); });
+	}
+
 }